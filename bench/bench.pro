@@ -0,0 +1,36 @@
+# Command line benchmark of box file I/O, it does not need leptonica nor
+# tesseract:
+#   qmake bench.pro && make && ./qbe-bench [lines] [directory]
+# Generated box file (1000000 lines by default) is removed afterwards.
+# Parse variants report peak memory of child process that runs them.
+
+TEMPLATE = app
+TARGET = qbe-bench
+
+QT -= gui
+CONFIG += console release warn_on
+CONFIG -= app_bundle
+
+OBJECTS_DIR += temp
+MOC_DIR += temp
+
+INCLUDEPATH += ../src
+
+SOURCES += main.cpp \
+    ../src/BoxParser.cpp \
+    ../src/BoxDocument.cpp \
+    ../src/BoxStore.cpp \
+    ../src/BoxCache.cpp \
+    ../src/BoxSerializer.cpp \
+    ../src/BoxSaveJob.cpp \
+    ../src/BoxGzip.cpp
+
+HEADERS += ../src/BoxParser.h \
+    ../src/BoxDocument.h \
+    ../src/BoxStore.h \
+    ../src/BoxCache.h \
+    ../src/BoxSerializer.h \
+    ../src/BoxSaveJob.h \
+    ../src/BoxGzip.h
+
+LIBS += -lz
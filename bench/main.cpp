@@ -0,0 +1,360 @@
+/**********************************************************************
+* File:        main.cpp
+* Description: Benchmark of box file parsing and saving
+* Author:      qt-box-editor contributors
+* Created:     2026-10-16
+*
+* (C) Copyright 2026, qt-box-editor contributors
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**    http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*
+**********************************************************************/
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QProcess>
+#include <QRegExp>
+#include <QStringList>
+#include <QTextStream>
+#include <QThread>
+#include <QVector>
+
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#endif
+
+#include "BoxDocument.h"
+#include "BoxGzip.h"
+#include "BoxParser.h"
+#include "BoxSaveJob.h"
+#include "BoxSerializer.h"
+#include "BoxStore.h"
+
+static const int kDefaultLines = 1000000;
+static const int kPages = 5;
+static const int kRuns = 3;  // the best run is reported
+
+typedef bool (*BenchFunction)(const QString& fileName);
+
+// Documents prepared by main() for save benchmarks
+static BoxDocument* mappedDocument = 0;  // rows are views of file
+static BoxDocument* editedDocument = 0;  // all pages are decoded
+
+static void print(const QString& text) {
+  QTextStream(stdout) << text << "\n";
+}
+
+// Box file with lines rows on kPages pages. Letters include multi-byte
+// UTF-8, ligature and font prefix.
+static bool generate(const QString& fileName, int lines) {
+  static const char* const kLetters[] = {
+    "a", "B", "7", "\xC4\x8D", "fi", "@x"
+  };
+  static const int kLetterCount = sizeof(kLetters) / sizeof(kLetters[0]);
+
+  QFile file(fileName);
+  if (!file.open(QFile::WriteOnly))
+    return false;
+  int pageRows = (lines + kPages - 1) / kPages;
+  QByteArray chunk;
+  for (int i = 0; i < lines; ++i) {
+    int left = (i * 37) % 2400;
+    int bottom = (i * 11) % 3400;
+    chunk += kLetters[i % kLetterCount];
+    chunk += ' ' + QByteArray::number(left);
+    chunk += ' ' + QByteArray::number(bottom);
+    chunk += ' ' + QByteArray::number(left + 10 + i % 40);
+    chunk += ' ' + QByteArray::number(bottom + 20 + i % 30);
+    chunk += ' ' + QByteArray::number(i / pageRows);
+    chunk += '\n';
+    if (chunk.size() >= BoxParser::kChunkSize) {
+      if (file.write(chunk) != chunk.size())
+        return false;
+      chunk.resize(0);
+    }
+  }
+  return file.write(chunk) == chunk.size();
+}
+
+// Peak resident set size of this process in KiB, -1 if not known
+static qint64 peakRss() {
+#ifdef Q_OS_UNIX
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    return -1;
+#ifdef Q_OS_MAC
+  return usage.ru_maxrss / 1024;  // bytes
+#else
+  return usage.ru_maxrss;
+#endif
+#else
+  return -1;
+#endif
+}
+
+// Run function kRuns times and print the best wall time and throughput
+// of bytes (size of uncompressed box data). Peak memory (KiB) is printed
+// if known.
+static void run(const QString& name, BenchFunction function,
+                const QString& fileName, qint64 bytes, qint64 peak = -1) {
+  qint64 best = -1;
+  for (int i = 0; i < kRuns; ++i) {
+    QElapsedTimer timer;
+    timer.start();
+    if (!function(fileName)) {
+      print(QString("%1: failed").arg(name));
+      return;
+    }
+    qint64 elapsed = timer.elapsed();
+    if (best < 0 || elapsed < best)
+      best = elapsed;
+  }
+  double rate = best > 0 ? bytes / 1024.0 / 1024.0 / (best / 1000.0) : 0;
+  QString line = QString("%1 %2 ms %3 MB/s").arg(name, -24).arg(best, 6)
+                 .arg(rate, 8, 'f', 1);
+  if (peak >= 0)
+    line += QString(" %1 MB peak").arg(peak / 1024.0, 8, 'f', 1);
+  print(line);
+}
+
+// Parse as ChildWidget::readToVector() did before BoxParser: whole file
+// decoded to QString and split to string lists
+static bool parseBaseline(const QString& fileName) {
+  QFile file(fileName);
+  if (!file.open(QFile::ReadOnly))
+    return false;
+  QTextStream boxdata(&file);
+  boxdata.setCodec("UTF-8");
+  QString data = boxdata.readAll();
+  QStringList lineBoxes = data.split(QRegExp("\n"),
+                                     QString::SkipEmptyParts);
+  QString pagePrev = "0";
+  QVector<QVector<QStringList> > pages;
+  QVector<QStringList> page;
+  for (int i = 0; i < lineBoxes.size(); ++i) {
+    QString line = lineBoxes.at(i);
+    QStringList box = line.split(" ");
+    if (box.size() == 7) {
+      if (line.startsWith(" "))
+        box.removeFirst();
+    } else if (box.size() != 6) {
+      return false;
+    }
+
+    if (box[5] == pagePrev) {
+      page.append(box);
+    } else {
+      pagePrev = box[5];
+      pages.append(page);
+      page.clear();
+      page.append(box);
+    }
+  }
+  pages.append(page);
+  return true;
+}
+
+// Stream read in chunks and decoded to columns (as .gz files are read)
+static bool parseStream(const QString& fileName) {
+  QFile file(fileName);
+  if (!file.open(QFile::ReadOnly))
+    return false;
+  QVector<BoxColumns> pages;
+  BoxStore store;
+  BoxParser parser(&pages, &store);
+  return parser.parse(&file);
+}
+
+// Mapped file indexed to row views (as box files are opened)
+static bool parseMapped(const QString& fileName, int threads) {
+  QFile file(fileName);
+  if (!file.open(QFile::ReadOnly))
+    return false;
+  qint64 size = file.size();
+  uchar* data = file.map(0, size);
+  if (!data)
+    return false;
+  QVector<QVector<BoxRow> > pages;
+  BoxParser parser(&pages);
+  bool ok = parser.parse(reinterpret_cast<const char*>(data), size, threads);
+  file.unmap(data);
+  return ok;
+}
+
+static bool parseMappedSingle(const QString& fileName) {
+  return parseMapped(fileName, 1);
+}
+
+static bool parseMappedParallel(const QString& fileName) {
+  return parseMapped(fileName, QThread::idealThreadCount());
+}
+
+static bool parseNothing(const QString& fileName) {
+  Q_UNUSED(fileName);
+  return true;
+}
+
+struct ParseVariant {
+  const char* name;
+  BenchFunction function;
+};
+
+// Peak memory is measured by running variant in child process (peak never
+// goes down). "start" is peak of process that parses nothing. Mapped file
+// counts to peak of mapped variants.
+static const ParseVariant kParseVariants[] = {
+  { "start", parseNothing },
+  { "parse baseline", parseBaseline },
+  { "parse stream", parseStream },
+  { "parse mapped", parseMappedSingle },
+  { "parse mapped parallel", parseMappedParallel }
+};
+static const int kParseVariantCount =
+  sizeof(kParseVariants) / sizeof(kParseVariants[0]);
+static const char kPeakOption[] = "--peak";
+
+// Peak memory (KiB) of child process that runs parse variant once
+static qint64 childPeakRss(int variant, const QString& fileName) {
+  QProcess child;
+  child.start(QCoreApplication::applicationFilePath(),
+              QStringList() << kPeakOption << QString::number(variant)
+                            << fileName);
+  if (!child.waitForFinished(-1) || child.exitCode() != 0)
+    return -1;
+  bool ok = false;
+  qint64 peak = child.readAllStandardOutput().trimmed().toLongLong(&ok);
+  return ok ? peak : -1;
+}
+
+// All rows of decoded pages formatted to memory, without any I/O
+static bool formatRows(const QString& fileName) {
+  Q_UNUSED(fileName);
+  QVector<QByteArray> glyphs = editedDocument->store().utf8Glyphs();
+  QByteArray out;
+  for (int p = 0; p < editedDocument->pageCount(); ++p) {
+    BoxColumns columns;
+    editedDocument->columns(p, &columns);
+    for (int r = 0; r < columns.size(); ++r) {
+      BoxSerializer::appendRow(&out, columns, r, glyphs,
+                               editedDocument->isWordStr());
+      out.append('\n');
+    }
+  }
+  return !out.isEmpty();
+}
+
+// Whole save (with sync to disk) as done by ChildWidget::save()
+static bool save(BoxDocument* document, const QString& fileName) {
+  BoxSaveJob* job = document->saveJob(fileName);
+  job->run();
+  bool ok = job->isOk();
+  delete job;
+  return ok;
+}
+
+// Unchanged pages are spliced as original bytes
+static bool saveClean(const QString& fileName) {
+  return save(mappedDocument, fileName + ".out");
+}
+
+// Edited pages are formatted row by row
+static bool saveEdited(const QString& fileName) {
+  return save(editedDocument, fileName + ".out");
+}
+
+// Compressed file is written on the fly (see BoxGzip)
+static bool saveCleanGzip(const QString& fileName) {
+  return save(mappedDocument, fileName + ".out.gz");
+}
+
+static bool saveEditedGzip(const QString& fileName) {
+  return save(editedDocument, fileName + ".out.gz");
+}
+
+// Compressed file inflated and parsed in chunks (as loadGzipBoxes() does),
+// compare with parse stream
+static bool parseGzip(const QString& fileName) {
+  QFile file(fileName + ".out.gz");
+  BoxGzip gzip(&file);
+  if (!file.open(QFile::ReadOnly) || !gzip.open(QIODevice::ReadOnly))
+    return false;
+  QVector<BoxColumns> pages;
+  BoxStore store;
+  BoxParser parser(&pages, &store);
+  return parser.parse(&gzip);
+}
+
+int main(int argc, char* argv[]) {
+  QCoreApplication app(argc, argv);
+  QStringList args = app.arguments();
+  if (args.size() == 4 && args.at(1) == kPeakOption) {
+    int variant = args.at(2).toInt();
+    if (variant < 0 || variant >= kParseVariantCount ||
+        !kParseVariants[variant].function(args.at(3)))
+      return 1;
+    print(QString::number(peakRss()));
+    return 0;
+  }
+
+  int lines = args.size() > 1 ? args.at(1).toInt() : kDefaultLines;
+  QString dir = args.size() > 2 ? args.at(2) : QDir::tempPath();
+  QString fileName = QDir(dir).absoluteFilePath("qbe-bench.box");
+
+  if (lines <= 0 || !generate(fileName, lines)) {
+    print(QString("Cannot generate %1").arg(fileName));
+    return 1;
+  }
+  qint64 bytes = QFileInfo(fileName).size();
+  print(QString("%1 lines, %2 bytes, best of %3 runs").arg(lines)
+        .arg(bytes).arg(kRuns));
+
+  qint64 startPeak = childPeakRss(0, fileName);
+  if (startPeak >= 0)
+    print(QString("%1 %2 MB peak").arg(QString(kParseVariants[0].name), -48)
+          .arg(startPeak / 1024.0, 8, 'f', 1));
+  for (int i = 1; i < kParseVariantCount; ++i)
+    run(kParseVariants[i].name, kParseVariants[i].function, fileName, bytes,
+        childPeakRss(i, fileName));
+
+  BoxDocument mapped;
+  BoxDocument edited;
+  QFile file(fileName);
+  if (!mapped.map(fileName) || !file.open(QFile::ReadOnly) ||
+      !edited.read(&file)) {
+    print(QString("Cannot read %1").arg(fileName));
+    return 1;
+  }
+  file.close();
+  mappedDocument = &mapped;
+  editedDocument = &edited;
+  run("format rows", formatRows, fileName, bytes);
+  run("save clean pages", saveClean, fileName, bytes);
+  run("save edited pages", saveEdited, fileName, bytes);
+
+  // Compressed against plain I/O, rates are of uncompressed data
+  run("save clean pages .gz", saveCleanGzip, fileName, bytes);
+  run("save edited pages .gz", saveEditedGzip, fileName, bytes);
+  run("parse stream .gz", parseGzip, fileName, bytes);
+  qint64 compressed = QFileInfo(fileName + ".out.gz").size();
+  print(QString("compressed to %1 bytes (%2 %)").arg(compressed)
+        .arg(100.0 * compressed / bytes, 0, 'f', 1));
+
+  mapped.clear();  // mapped file can not be removed on Windows
+  QFile::remove(fileName + ".out");
+  QFile::remove(fileName + ".out.gz");
+  QFile::remove(fileName);
+  return 0;
+}
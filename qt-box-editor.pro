@@ -33,6 +33,18 @@ FORMS += \
 SOURCES += src/main.cpp \
     src/MainWindow.cpp \
     src/ChildWidget.cpp \
+    src/BoxParser.cpp \
+    src/BoxDocument.cpp \
+    src/BoxStore.cpp \
+    src/BoxTableModel.cpp \
+    src/BoxLayer.cpp \
+    src/BoxCache.cpp \
+    src/BoxSerializer.cpp \
+    src/BoxSaveJob.cpp \
+    src/BoxJournal.cpp \
+    src/BoxValidator.cpp \
+    src/BoxGzip.cpp \
+    src/BoxUndoLog.cpp \
     src/DelegateEditors.cpp \
     src/TessTools.cpp \
     dialogs/SettingsDialog.cpp \
@@ -43,6 +55,18 @@ SOURCES += src/main.cpp \
 
 HEADERS += src/MainWindow.h \
     src/ChildWidget.h \
+    src/BoxParser.h \
+    src/BoxDocument.h \
+    src/BoxStore.h \
+    src/BoxTableModel.h \
+    src/BoxLayer.h \
+    src/BoxCache.h \
+    src/BoxSerializer.h \
+    src/BoxSaveJob.h \
+    src/BoxJournal.h \
+    src/BoxValidator.h \
+    src/BoxGzip.h \
+    src/BoxUndoLog.h \
     src/Settings.h \
     src/TessTools.h \
     src/DelegateEditors.h \
@@ -58,7 +82,7 @@ RESOURCES = resources/application.qrc \
     resources/QBE-Oxygen.qrc \
     resources/QBE-Tango.qrc
 
-LIBS += -llept -ltesseract
+LIBS += -llept -ltesseract -lz
 
 win32 {
     DESTDIR = ./win32
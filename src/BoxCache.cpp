@@ -0,0 +1,127 @@
+/**********************************************************************
+* File:        BoxCache.cpp
+* Description: Binary sidecar cache of box file page index
+* Author:      qt-box-editor contributors
+* Created:     2026-10-16
+*
+* (C) Copyright 2026, qt-box-editor contributors
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**    http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*
+**********************************************************************/
+
+#include <string.h>
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+
+#include "BoxCache.h"
+
+static const quint32 kCacheMagic = 0x51424543;  // "QBEC"
+static const quint32 kCacheVersion = 3;
+
+QString BoxCache::cacheFileName(const QString& boxFile) {
+  return boxFile + ".qbecache";
+}
+
+quint64 BoxCache::hash(const char* data, qint64 size) {
+  const quint64 prime = Q_UINT64_C(0xff51afd7ed558ccd);
+  quint64 h = Q_UINT64_C(0x9e3779b97f4a7c15) ^ static_cast<quint64>(size);
+  const char* end = data + (size & ~static_cast<qint64>(7));
+
+  for (; data < end; data += 8) {
+    quint64 word;
+    memcpy(&word, data, 8);
+    h = (h ^ word) * prime;
+    h ^= h >> 32;
+  }
+  if (size & 7) {
+    quint64 word = 0;
+    memcpy(&word, data, static_cast<size_t>(size & 7));
+    h = (h ^ word) * prime;
+  }
+  h ^= h >> 29;
+  return h;
+}
+
+bool BoxCache::read(const QString& boxFile, const char* data, qint64 size,
+                    QVector<BoxPageRange>* ranges) {
+  QFile file(cacheFileName(boxFile));
+  if (!file.open(QFile::ReadOnly))
+    return false;
+  QDataStream in(&file);
+  in.setVersion(QDataStream::Qt_4_6);
+
+  quint32 magic, version;
+  qint64 cachedSize, cachedTime;
+  in >> magic >> version >> cachedSize >> cachedTime;
+  if (in.status() != QDataStream::Ok || magic != kCacheMagic ||
+      version != kCacheVersion)
+    return false;
+  // Cheap checks first, hash needs to read whole box data
+  QFileInfo info(boxFile);
+  if (cachedSize != size || cachedSize != info.size() ||
+      cachedTime != info.lastModified().toMSecsSinceEpoch())
+    return false;
+
+  quint64 cachedHash;
+  qint32 count;
+  in >> cachedHash >> count;
+  if (in.status() != QDataStream::Ok || count < 0 ||
+      cachedHash != hash(data, size))
+    return false;
+
+  QVector<BoxPageRange> result(count);
+  for (int p = 0; p < count; ++p)
+    in >> result[p].begin;
+  for (int p = 0; p < count; ++p)
+    in >> result[p].end;
+  for (int p = 0; p < count; ++p) {
+    qint32 rows;
+    in >> rows;
+    result[p].rows = rows;
+  }
+  if (in.status() != QDataStream::Ok)
+    return false;
+  for (int p = 0; p < count; ++p) {
+    const BoxPageRange& range = result.at(p);
+    if (range.begin < 0 || range.begin > range.end || range.end > size ||
+        range.rows < 0)
+      return false;
+  }
+  *ranges = result;
+  return true;
+}
+
+bool BoxCache::write(const QString& boxFile, const char* data, qint64 size,
+                     const QVector<BoxPageRange>& ranges) {
+  QFile file(cacheFileName(boxFile));
+  if (!file.open(QFile::WriteOnly))
+    return false;
+  QDataStream out(&file);
+  out.setVersion(QDataStream::Qt_4_6);
+
+  out << kCacheMagic << kCacheVersion << size
+      << static_cast<qint64>(QFileInfo(boxFile).lastModified()
+                             .toMSecsSinceEpoch())
+      << hash(data, size) << static_cast<qint32>(ranges.size());
+  for (int p = 0; p < ranges.size(); ++p)
+    out << ranges.at(p).begin;
+  for (int p = 0; p < ranges.size(); ++p)
+    out << ranges.at(p).end;
+  for (int p = 0; p < ranges.size(); ++p)
+    out << static_cast<qint32>(ranges.at(p).rows);
+  return out.status() == QDataStream::Ok && file.error() == QFile::NoError;
+}
@@ -0,0 +1,55 @@
+/**********************************************************************
+* File:        BoxCache.h
+* Description: Binary sidecar cache of box file page index
+* Author:      qt-box-editor contributors
+* Created:     2026-10-16
+*
+* (C) Copyright 2026, qt-box-editor contributors
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**    http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*
+**********************************************************************/
+
+#ifndef SRC_BOXCACHE_H_
+#define SRC_BOXCACHE_H_
+
+#include <QString>
+#include <QVector>
+
+#include "BoxParser.h"
+
+/**
+ * Sidecar file (<box file>.qbecache) with page index of a box file.
+ *
+ * Page ranges are stored column by column (all begins, all ends, all row
+ * counts). Cache is valid only if size, modification time and hash of
+ * whole box data match the values stored with it, so a stale or foreign
+ * cache is simply ignored and the box file is parsed again. Rows of pages
+ * are decoded without validation, so no part of data may be left out of
+ * the hash.
+ */
+class BoxCache {
+  public:
+    static QString cacheFileName(const QString& boxFile);
+    /** Fast 64-bit hash of data (not portable between architectures). */
+    static quint64 hash(const char* data, qint64 size);
+
+    /** Read page ranges of boxFile whose content is data. */
+    static bool read(const QString& boxFile, const char* data, qint64 size,
+                     QVector<BoxPageRange>* ranges);
+    /** Store page ranges of boxFile whose content is data. */
+    static bool write(const QString& boxFile, const char* data, qint64 size,
+                      const QVector<BoxPageRange>& ranges);
+};
+
+#endif  // SRC_BOXCACHE_H_
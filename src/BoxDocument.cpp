@@ -0,0 +1,487 @@
+/**********************************************************************
+* File:        BoxDocument.cpp
+* Description: Box data of all pages with memory mapped backing store
+* Author:      qt-box-editor contributors
+* Created:     2026-10-16
+*
+* (C) Copyright 2026, qt-box-editor contributors
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**    http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*
+**********************************************************************/
+
+#include <string.h>
+#ifndef Q_OS_WIN
+#include <sys/stat.h>
+#endif
+
+#include <QFileInfo>
+
+#include "BoxCache.h"
+#include "BoxDocument.h"
+#include "BoxSaveJob.h"
+#include "BoxSerializer.h"
+
+BoxDocument::BoxDocument()
+  : m_recentRows(0),
+    m_pageBudget(64 * 1024 * 1024),
+    m_lazy(false),
+    m_cache(false),
+    m_wordStr(false),
+    m_generation(0),
+    m_replaced(false),
+    m_fileDevice(0),
+    m_fileInode(0),
+    m_data(0),
+    m_size(0),
+    m_errorLine(0),
+    m_errorFields(0) {
+}
+
+BoxMapping::~BoxMapping() {
+  file->unmap(data);
+  file->close();
+  delete file;
+}
+
+void BoxDocument::clear() {
+  m_pages.clear();
+  m_columns.clear();
+  m_store.clear();
+  m_state.clear();
+  m_ranges.clear();
+  m_recent.clear();
+  m_recentRows = 0;
+  m_wordStr = false;
+  unmap();
+  m_fileName.clear();
+  m_buffer.clear();
+  m_data = 0;
+  m_size = 0;
+}
+
+bool BoxDocument::map(const QString& fileName, int threads) {
+  clear();
+  m_errorLine = 0;
+  m_errorFields = 0;
+  m_errorString.clear();
+
+  if (!mapFile(fileName))
+    return false;
+
+  // Valid cache saves parsing, data was validated when cache was written
+  QVector<BoxPageRange> ranges;
+  bool cached = m_cache && BoxCache::read(fileName, m_data, m_size, &ranges);
+
+  if (m_lazy) {
+    if (!cached) {
+      BoxParser parser(&ranges);
+      if (!parser.parse(m_data, m_size, threads)) {
+        m_errorLine = parser.errorLine();
+        m_errorFields = parser.errorFieldCount();
+        return false;
+      }
+      m_wordStr = parser.hasWordStr();
+    }
+    m_ranges = ranges;
+    m_pages.resize(m_ranges.size());
+    syncState(PageUnloaded);
+  } else if (cached) {
+    m_pages.resize(ranges.size());
+    for (int p = 0; p < ranges.size(); ++p)
+      BoxParser::indexRows(m_data, ranges.at(p), &m_pages[p]);
+    syncState(PageClean);
+  } else {
+    BoxParser parser(&m_pages);
+    bool ok = parser.parse(m_data, m_size, threads);
+    m_wordStr = parser.hasWordStr();
+    syncState(PageClean);
+    if (!ok) {
+      m_errorLine = parser.errorLine();
+      m_errorFields = parser.errorFieldCount();
+      return false;
+    }
+  }
+
+  if (cached)
+    m_wordStr = firstRowIsWordStr(ranges);  // files are not mixed
+  if (m_cache && !cached)
+    BoxCache::write(fileName, m_data, m_size, pageRanges());
+  return true;
+}
+
+bool BoxDocument::read(QIODevice* device) {
+  m_errorLine = 0;
+  m_errorFields = 0;
+  m_errorString.clear();
+
+  QVector<BoxColumns> pages;
+  BoxParser parser(&pages, &m_store);
+  bool ok = parser.parse(device);
+  m_wordStr = m_wordStr || parser.hasWordStr();
+  ++m_generation;
+  int first = m_pages.size();
+  m_pages.resize(first + pages.size());
+  syncState(PageEdited);  // there is no file to view, pages are decoded
+  for (int p = 0; p < pages.size(); ++p)
+    m_columns[first + p] = pages.at(p);
+  if (!ok) {
+    m_errorLine = parser.errorLine();
+    m_errorFields = parser.errorFieldCount();
+    m_errorString = device->errorString();
+    return false;
+  }
+  return true;
+}
+
+BoxSaveJob* BoxDocument::saveJob(const QString& fileName) {
+  bool ownFile = isOwnFile(fileName);
+#ifdef Q_OS_WIN
+  // Windows cannot replace mapped file
+  if (ownFile)
+    detach();
+#endif
+
+  BoxSaveJob* job = new BoxSaveJob(fileName);
+  job->m_pages = m_pages;
+  job->m_columns = m_columns;
+  job->m_glyphs = m_store.utf8Glyphs();
+  job->m_wordStr = m_wordStr;
+  job->m_unloaded.resize(m_pages.size());
+  job->m_clean.resize(m_pages.size());
+  for (int p = 0; p < m_pages.size(); ++p) {
+    job->m_unloaded[p] = (m_state.at(p) == PageUnloaded);
+    job->m_clean[p] = (m_state.at(p) != PageEdited);
+  }
+  job->m_ranges = m_ranges;
+  job->m_mapping = m_mapping;
+  job->m_buffer = m_buffer;
+  job->m_data = m_data;
+  job->m_size = m_size;
+  job->m_generation = m_generation;
+  job->m_ownFile = ownFile;
+  return job;
+}
+
+bool BoxDocument::finishSave(BoxSaveJob* job) {
+  if (!job->m_ok) {
+    m_errorString = job->m_errorString;
+    return false;
+  }
+  if (!job->m_ownFile)
+    return true;
+  if (job->m_generation != m_generation) {
+    // Pages were changed meanwhile and they are views of the old file.
+    // Its mapping still holds the old content, the file was replaced.
+    m_replaced = true;
+    return true;
+  }
+
+  // Rows become views of the new file, the whole output was never held in
+  // memory. If it can not be read back, rows stay views of old mapping.
+  QString fileName = job->fileName();
+  if (!mapFile(fileName)) {
+    // e.g. empty file, rows are backed by copy of it
+    QFile file(fileName);
+    if (!file.open(QFile::ReadOnly)) {
+      m_replaced = true;
+      return true;
+    }
+    unmap();
+    m_buffer = file.readAll();
+    m_data = m_buffer.constData();
+    m_size = m_buffer.size();
+  }
+  m_pages = job->m_rebased;
+  m_columns = QVector<BoxColumns>(m_pages.size());
+  if (m_lazy)
+    m_ranges = job->m_rebasedRanges;
+
+  // All loaded rows are views of written data now, so all pages are clean
+  QList<int> recent;
+  QVector<bool> isRecent(m_pages.size(), false);
+  for (int i = 0; i < m_recent.size(); ++i) {
+    int page = m_recent.at(i);
+    if (!job->m_unloaded.at(page)) {
+      recent.append(page);
+      isRecent[page] = true;
+    }
+  }
+  m_recentRows = 0;
+  for (int p = 0; p < m_pages.size(); ++p) {
+    if (job->m_unloaded.at(p)) {
+      m_state[p] = PageUnloaded;
+      continue;
+    }
+    m_state[p] = PageClean;
+    if (!m_lazy)
+      continue;
+    if (!isRecent.at(p))
+      recent.append(p);
+    m_recentRows += m_pages.at(p).size();
+  }
+  m_recent = m_lazy ? recent : QList<int>();
+  evictPages();
+
+  if (m_cache)
+    BoxCache::write(fileName, m_data, m_size, job->m_rebasedRanges);
+  return true;
+}
+
+void BoxDocument::detach() {
+  if (m_mapping.isNull())
+    return;
+
+  QByteArray copy(m_data, static_cast<int>(m_size));
+  unmap();
+  m_buffer = copy;
+  m_data = m_buffer.constData();
+}
+
+bool BoxDocument::isChangedInPlace() const {
+  if (m_mapping.isNull() || m_replaced)
+    return false;
+#ifdef Q_OS_WIN
+  // Mapped file can be neither removed nor replaced on Windows
+  return QFile::exists(m_fileName);
+#else
+  // Other inode means file was replaced or removed - mapping still shows
+  // old content then
+  struct stat info;
+  if (stat(QFile::encodeName(m_fileName).constData(), &info) != 0)
+    return false;
+  return static_cast<qint64>(info.st_dev) == m_fileDevice &&
+         static_cast<qint64>(info.st_ino) == m_fileInode;
+#endif
+}
+
+void BoxDocument::loadPage(int page) {
+  if (page < 0 || page >= m_pages.size())
+    return;
+  if (m_state.at(page) == PageUnloaded) {
+    BoxParser::indexRows(m_data, m_ranges.at(page), &m_pages[page]);
+    m_state[page] = PageClean;
+    m_recentRows += m_pages.at(page).size();
+    m_recent.prepend(page);
+    evictPages();
+  } else {
+    touchPage(page);
+  }
+}
+
+void BoxDocument::columns(int page, BoxColumns* columns) {
+  if (page < 0 || page >= m_pages.size())
+    columns->clear();
+  else if (m_state.at(page) == PageEdited)
+    *columns = m_columns.at(page);
+  else {
+    loadPage(page);
+    decodePage(page, columns);
+  }
+}
+
+QByteArray BoxDocument::rowBytes(int page, int row) const {
+  Q_ASSERT(m_state.at(page) != PageUnloaded);
+  if (m_state.at(page) == PageEdited) {
+    QByteArray line;
+    BoxSerializer::appendRow(&line, m_columns.at(page), row,
+                             m_store.utf8Glyphs(), m_wordStr);
+    return line;
+  }
+  const BoxRow& boxRow = m_pages.at(page).at(row);
+  return QByteArray::fromRawData(m_data + boxRow.offset, boxRow.length);
+}
+
+qint64 BoxDocument::rowOffset(int page, int row) const {
+  Q_ASSERT(m_state.at(page) != PageUnloaded);
+  if (m_state.at(page) == PageEdited)
+    return -1;
+  return m_pages.at(page).at(row).offset;
+}
+
+void BoxDocument::setPage(int page, const BoxColumns& columns) {
+  if (page < m_pages.size()) {
+    loadPage(page);
+    BoxColumns old;
+    this->columns(page, &old);
+    if (old == columns)
+      return;  // clean page stays a view of file
+  }
+  editPage(page) = columns;
+}
+
+bool BoxDocument::setRow(int page, int row, const QByteArray& line) {
+  if (page < 0 || row < 0 || row >= pageRows(page))
+    return false;
+  BoxColumns box;
+  if (!m_store.appendLine(&box, line.constData(),
+                          line.constData() + line.size()))
+    return false;
+  editPage(page).replace(row, box, 0);
+  return true;
+}
+
+bool BoxDocument::insertRow(int page, int row, const QByteArray& line) {
+  if (page < 0 || row < 0 || row > pageRows(page))
+    return false;
+  BoxColumns box;
+  if (!m_store.appendLine(&box, line.constData(),
+                          line.constData() + line.size()))
+    return false;
+  editPage(page).insert(row, box, 0);
+  return true;
+}
+
+bool BoxDocument::removeRow(int page, int row) {
+  if (page < 0 || row < 0 || row >= pageRows(page))
+    return false;
+  editPage(page).remove(row);
+  return true;
+}
+
+bool BoxDocument::mapFile(const QString& fileName) {
+  QFile* file = new QFile(fileName);
+  if (!file->open(QFile::ReadOnly)) {
+    m_errorString = file->errorString();
+    delete file;
+    return false;
+  }
+  qint64 size = file->size();
+  uchar* map = (size > 0) ? file->map(0, size) : 0;
+  if (!map) {
+    m_errorString = file->errorString();
+    delete file;
+    return false;
+  }
+
+  m_fileDevice = 0;
+  m_fileInode = 0;
+#ifndef Q_OS_WIN
+  struct stat info;
+  if (fstat(file->handle(), &info) == 0) {
+    m_fileDevice = static_cast<qint64>(info.st_dev);
+    m_fileInode = static_cast<qint64>(info.st_ino);
+  }
+#endif
+
+  m_mapping = QSharedPointer<BoxMapping>(new BoxMapping(file, map));
+  m_buffer.clear();
+  m_fileName = fileName;
+  m_replaced = false;
+  m_data = reinterpret_cast<const char*>(map);
+  m_size = size;
+  return true;
+}
+
+void BoxDocument::unmap() {
+  m_mapping.clear();
+}
+
+bool BoxDocument::isOwnFile(const QString& fileName) const {
+  return !m_fileName.isEmpty() &&
+         QFileInfo(fileName).canonicalFilePath() ==
+         QFileInfo(m_fileName).canonicalFilePath();
+}
+
+int BoxDocument::pageRows(int page) const {
+  return page < m_pages.size() ? rowCount(page) : 0;
+}
+
+BoxColumns& BoxDocument::editPage(int page) {
+  if (page >= m_pages.size()) {
+    m_pages.resize(page + 1);
+    syncState(PageEdited);
+  }
+  loadPage(page);
+  if (m_state.at(page) == PageClean) {
+    decodePage(page, &m_columns[page]);
+    if (m_recent.removeOne(page))
+      m_recentRows -= m_pages.at(page).size();
+    m_pages[page] = QVector<BoxRow>();
+    m_state[page] = PageEdited;
+  }
+  ++m_generation;
+  return m_columns[page];
+}
+
+void BoxDocument::decodePage(int page, BoxColumns* columns) {
+  const QVector<BoxRow>& rows = m_pages.at(page);
+  columns->clear();
+  columns->reserve(rows.size());
+  for (int r = 0; r < rows.size(); ++r) {
+    const char* begin = m_data + rows.at(r).offset;
+    m_store.appendLine(columns, begin, begin + rows.at(r).length);
+  }
+}
+
+void BoxDocument::syncState(PageState state) {
+  m_columns.resize(m_pages.size());
+  int size = m_state.size();
+  m_state.resize(m_pages.size());
+  for (int p = size; p < m_state.size(); ++p)
+    m_state[p] = state;
+}
+
+void BoxDocument::touchPage(int page) {
+  if (m_recent.isEmpty() || m_recent.first() == page)
+    return;
+  if (m_recent.removeOne(page))
+    m_recent.prepend(page);
+}
+
+void BoxDocument::evictPages() {
+  // The most recent page (the one shown) always stays
+  while (m_recent.size() > 1 &&
+         m_recentRows * static_cast<qint64>(sizeof(BoxRow)) > m_pageBudget) {
+    int page = m_recent.takeLast();
+    m_recentRows -= m_pages.at(page).size();
+    m_pages[page] = QVector<BoxRow>();
+    m_state[page] = PageUnloaded;
+  }
+}
+
+// Valid only while all rows are views in file order (after map())
+QVector<BoxPageRange> BoxDocument::pageRanges() const {
+  QVector<BoxPageRange> ranges(m_pages.size());
+  for (int p = 0; p < m_pages.size(); ++p) {
+    if (m_state.at(p) == PageUnloaded) {
+      ranges[p] = m_ranges.at(p);
+      continue;
+    }
+    const QVector<BoxRow>& rows = m_pages.at(p);
+    if (rows.isEmpty())
+      continue;
+    ranges[p].begin = rows.first().offset;
+    ranges[p].end = rows.last().offset + rows.last().length;
+    ranges[p].rows = rows.size();
+  }
+  return ranges;
+}
+
+bool BoxDocument::firstRowIsWordStr(
+  const QVector<BoxPageRange>& ranges) const {
+  for (int p = 0; p < ranges.size(); ++p) {
+    if (ranges.at(p).rows == 0)
+      continue;
+    const char* begin = m_data + ranges.at(p).begin;
+    const char* end = m_data + ranges.at(p).end;
+    const char* newline =
+      static_cast<const char*>(memchr(begin, '\n', end - begin));
+    if (newline)
+      end = newline;
+    if (end > begin && *(end - 1) == '\r')
+      --end;
+    return BoxParser::wordStrText(begin, end) != 0;
+  }
+  return false;
+}
@@ -0,0 +1,216 @@
+/**********************************************************************
+* File:        BoxDocument.h
+* Description: Box data of all pages with memory mapped backing store
+* Author:      qt-box-editor contributors
+* Created:     2026-10-16
+*
+* (C) Copyright 2026, qt-box-editor contributors
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**    http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*
+**********************************************************************/
+
+#ifndef SRC_BOXDOCUMENT_H_
+#define SRC_BOXDOCUMENT_H_
+
+#include <QByteArray>
+#include <QFile>
+#include <QList>
+#include <QSharedPointer>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include "BoxParser.h"
+#include "BoxStore.h"
+
+class BoxSaveJob;
+
+/**
+ * Read-only mapping of box file. It is shared by document and running
+ * saves, so a save can finish reading data the document already dropped.
+ */
+struct BoxMapping {
+    BoxMapping(QFile* f, uchar* d) : file(f), data(d) {}
+    ~BoxMapping();
+
+    QFile* file;
+    uchar* data;
+
+  private:
+    Q_DISABLE_COPY(BoxMapping)
+};
+
+/**
+ * Holds boxes of all pages.
+ *
+ * A box file opened with map() is not copied to memory: every row is just
+ * an offset/length view into the mapping. Pages changed by setPage() (or
+ * read from a stream) are decoded to BoxColumns, so open time and resident
+ * memory depend on number of edits rather than on file size.
+ *
+ * In lazy mode map() builds only byte range of every page. Rows of page are
+ * indexed by loadPage() when the page is shown and unedited pages are
+ * dropped again (least recently used first) once they exceed page budget.
+ */
+class BoxDocument {
+  public:
+    BoxDocument();
+
+    /** Drop all pages and release mapping. */
+    void clear();
+    /** Index only page ranges in next map(). */
+    void setLazy(bool lazy) {
+        m_lazy = lazy;
+    }
+    /** Use sidecar cache of page index (see BoxCache) when (re)mapping. */
+    void setCacheEnabled(bool enabled) {
+        m_cache = enabled;
+    }
+    /** Memory (in bytes) for row index of unedited pages in lazy mode. */
+    void setPageBudget(qint64 bytes) {
+        m_pageBudget = bytes;
+    }
+    /**
+     * Map fileName read-only and index its rows (no strings created).
+     * Big files are indexed by up to 'threads' threads.
+     */
+    bool map(const QString& fileName, int threads = 1);
+    /** Parse device and append its pages (decoded to columns). */
+    bool read(QIODevice* device);
+    /**
+     * Snapshot all pages for writing to fileName. Caller runs the job
+     * (usually in other thread) and passes it to finishSave() afterwards.
+     */
+    BoxSaveJob* saveJob(const QString& fileName);
+    /**
+     * Take result of finished job. If nothing was changed since snapshot
+     * and job wrote our own file, rows become views of the new file.
+     */
+    bool finishSave(BoxSaveJob* job);
+    /**
+     * Copy mapped data to memory. Only valid while mapped bytes are ours,
+     * i.e. file was not changed in place.
+     */
+    void detach();
+    /**
+     * Mapped file was rewritten in place by other program: unedited rows
+     * show foreign bytes and document has to be read again.
+     */
+    bool isChangedInPlace() const;
+
+    bool isMapped() const {
+        return !m_mapping.isNull();
+    }
+    int pageCount() const {
+        return m_pages.size();
+    }
+    /** Box file is line-level (WordStr rows, see BoxParser). */
+    bool isWordStr() const {
+        return m_wordStr;
+    }
+    int rowCount(int page) const {
+        if (m_state.at(page) == PageUnloaded)
+            return m_ranges.at(page).rows;
+        if (m_state.at(page) == PageEdited)
+            return m_columns.at(page).size();
+        return m_pages.at(page).size();
+    }
+    /** Glyph table of decoded boxes. */
+    BoxStore& store() {
+        return m_store;
+    }
+    const BoxStore& store() const {
+        return m_store;
+    }
+    /** Make sure rows of page are indexed, must precede reading page. */
+    void loadPage(int page);
+    /** Decoded boxes of page. */
+    void columns(int page, BoxColumns* columns);
+    /** Raw (or formatted, if page was edited) line of row. */
+    QByteArray rowBytes(int page, int row) const;
+    /** Base of row offsets, i.e. the mapped (or read) file data. */
+    const char* data() const {
+        return m_data;
+    }
+    /** Offset of row in data(), -1 if page was edited. */
+    qint64 rowOffset(int page, int row) const;
+    /**
+     * Replace page with boxes. Page that did not change stays a view of
+     * the file, so it is saved by copying its original bytes.
+     */
+    void setPage(int page, const BoxColumns& columns);
+    /** Single row edits (e.g. replayed journal), false if out of page. */
+    bool setRow(int page, int row, const QByteArray& line);
+    bool insertRow(int page, int row, const QByteArray& line);
+    bool removeRow(int page, int row);
+
+    /** 1-based line of the format error of the last map()/read() */
+    int errorLine() const {
+        return m_errorLine;
+    }
+    int errorFieldCount() const {
+        return m_errorFields;
+    }
+    QString errorString() const {
+        return m_errorString;
+    }
+
+  private:
+    enum PageState {
+        PageClean,     /**< rows are views in original order */
+        PageUnloaded,  /**< only range of page is known */
+        PageEdited     /**< decoded to m_columns, never dropped */
+    };
+
+    bool mapFile(const QString& fileName);
+    void unmap();
+    bool isOwnFile(const QString& fileName) const;
+    int pageRows(int page) const;
+    BoxColumns& editPage(int page);
+    void decodePage(int page, BoxColumns* columns);
+    void syncState(PageState state);
+    void touchPage(int page);
+    void evictPages();
+    QVector<BoxPageRange> pageRanges() const;
+    bool firstRowIsWordStr(const QVector<BoxPageRange>& ranges) const;
+
+    QVector<QVector<BoxRow> > m_pages;  /**< views, empty if edited */
+    QVector<BoxColumns> m_columns;      /**< boxes of edited pages */
+    BoxStore m_store;
+    QVector<PageState> m_state;
+    QVector<BoxPageRange> m_ranges;  /**< page ranges, lazy mode only */
+    QList<int> m_recent;  /**< loaded unedited pages, most recent first */
+    int m_recentRows;     /**< number of rows of m_recent pages */
+    qint64 m_pageBudget;
+    bool m_lazy;
+    bool m_cache;
+    bool m_wordStr;
+    int m_generation;     /**< changed with every change of pages */
+    QString m_fileName;   /**< file views come from */
+    QSharedPointer<BoxMapping> m_mapping;
+    bool m_replaced;      /**< mapped file was replaced by save */
+    qint64 m_fileDevice;  /**< device and inode of mapped file */
+    qint64 m_fileInode;
+    QByteArray m_buffer;  /**< backing store of views if not mapped */
+    const char* m_data;   /**< base of all view offsets */
+    qint64 m_size;
+
+    int m_errorLine;
+    int m_errorFields;
+    QString m_errorString;
+
+    Q_DISABLE_COPY(BoxDocument)
+};
+
+#endif  // SRC_BOXDOCUMENT_H_
@@ -0,0 +1,176 @@
+/**********************************************************************
+* File:        BoxGzip.cpp
+* Description: Streaming gzip (de)compression of box files
+* Author:      qt-box-editor contributors
+* Created:     2026-10-16
+*
+* (C) Copyright 2026, qt-box-editor contributors
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**    http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*
+**********************************************************************/
+
+#include <string.h>
+#include <zlib.h>
+
+#include <QCoreApplication>
+
+#include "BoxGzip.h"
+
+// windowBits for gzip header and trailer instead of zlib ones
+static const int kGzipWindowBits = 16 + MAX_WBITS;
+// zlib counts in uInt
+static const qint64 kMaxPiece = 0x40000000;
+
+BoxGzip::BoxGzip(QIODevice* device, QObject* parent)
+  : QIODevice(parent),
+    m_device(device),
+    m_stream(0),
+    m_end(false) {
+}
+
+BoxGzip::~BoxGzip() {
+  close();
+}
+
+bool BoxGzip::isGzipFile(const QString& fileName) {
+  return fileName.endsWith(".gz", Qt::CaseInsensitive);
+}
+
+bool BoxGzip::open(OpenMode mode) {
+  bool reading = (mode & ReadWrite) == ReadOnly;
+  if (isOpen() || (mode & ReadWrite) == ReadWrite)
+    return false;
+
+  m_stream = new z_stream;
+  memset(m_stream, 0, sizeof(z_stream));
+  int result = reading
+               ? inflateInit2(m_stream, kGzipWindowBits)
+               : deflateInit2(m_stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                              kGzipWindowBits, 8, Z_DEFAULT_STRATEGY);
+  if (result != Z_OK) {
+    setZlibError(result);
+    delete m_stream;
+    m_stream = 0;
+    return false;
+  }
+  m_buffer.resize(kChunkSize);
+  m_end = false;
+  // BoxParser reads big chunks itself, QIODevice buffer is not needed
+  return QIODevice::open(mode | Unbuffered);
+}
+
+bool BoxGzip::finish() {
+  if (!m_stream || !(openMode() & WriteOnly) || m_end)
+    return m_end;
+  m_end = true;
+  m_stream->next_in = 0;
+  m_stream->avail_in = 0;
+  return deflateTo(Z_FINISH);
+}
+
+void BoxGzip::close() {
+  if (!isOpen())
+    return;
+  if (m_stream) {
+    if (openMode() & WriteOnly) {
+      finish();
+      deflateEnd(m_stream);
+    } else {
+      inflateEnd(m_stream);
+    }
+    delete m_stream;
+    m_stream = 0;
+  }
+  QIODevice::close();
+}
+
+qint64 BoxGzip::readData(char* data, qint64 maxSize) {
+  if (m_end)
+    return 0;
+
+  uInt size = static_cast<uInt>(qMin(maxSize, kMaxPiece));
+  m_stream->next_out = reinterpret_cast<Bytef*>(data);
+  m_stream->avail_out = size;
+  // Block until some data are inflated, 0 means end of stream
+  while (m_stream->avail_out == size) {
+    if (m_stream->avail_in == 0) {
+      qint64 read = m_device->read(m_buffer.data(), kChunkSize);
+      if (read < 0) {
+        setErrorString(m_device->errorString());
+        return -1;
+      }
+      if (read == 0) {
+        setErrorString(QCoreApplication::translate(
+                         "BoxGzip", "Unexpected end of compressed data"));
+        return -1;
+      }
+      m_stream->next_in = reinterpret_cast<Bytef*>(m_buffer.data());
+      m_stream->avail_in = static_cast<uInt>(read);
+    }
+
+    int result = inflate(m_stream, Z_NO_FLUSH);
+    if (result == Z_STREAM_END) {
+      if (m_stream->avail_in == 0 && m_device->atEnd()) {
+        m_end = true;
+        break;
+      }
+      inflateReset(m_stream);  // next gzip member follows
+    } else if (result != Z_OK) {
+      setZlibError(result);
+      return -1;
+    }
+  }
+  return size - m_stream->avail_out;
+}
+
+qint64 BoxGzip::writeData(const char* data, qint64 size) {
+  qint64 written = 0;
+  while (written < size) {
+    qint64 piece = qMin(size - written, kMaxPiece);
+    m_stream->next_in =
+      reinterpret_cast<Bytef*>(const_cast<char*>(data + written));
+    m_stream->avail_in = static_cast<uInt>(piece);
+    if (!deflateTo(Z_NO_FLUSH))
+      return -1;
+    written += piece;
+  }
+  return size;
+}
+
+bool BoxGzip::deflateTo(int flush) {
+  int result;
+  do {
+    m_stream->next_out = reinterpret_cast<Bytef*>(m_buffer.data());
+    m_stream->avail_out = kChunkSize;
+    result = deflate(m_stream, flush);
+    if (result == Z_STREAM_ERROR) {
+      setZlibError(result);
+      return false;
+    }
+    qint64 have = kChunkSize - m_stream->avail_out;
+    if (have > 0 && m_device->write(m_buffer.constData(), have) != have) {
+      setErrorString(m_device->errorString());
+      return false;
+    }
+  } while (flush == Z_FINISH ? result != Z_STREAM_END
+                             : m_stream->avail_out == 0);
+  return true;
+}
+
+void BoxGzip::setZlibError(int result) {
+  if (m_stream && m_stream->msg)
+    setErrorString(QString::fromLatin1(m_stream->msg));
+  else
+    setErrorString(QString::fromLatin1(zError(result)));
+}
@@ -0,0 +1,75 @@
+/**********************************************************************
+* File:        BoxGzip.h
+* Description: Streaming gzip (de)compression of box files
+* Author:      qt-box-editor contributors
+* Created:     2026-10-16
+*
+* (C) Copyright 2026, qt-box-editor contributors
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**    http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*
+**********************************************************************/
+
+#ifndef SRC_BOXGZIP_H_
+#define SRC_BOXGZIP_H_
+
+#include <QByteArray>
+#include <QIODevice>
+#include <QString>
+
+struct z_stream_s;
+
+/**
+ * Sequential device that inflates (ReadOnly) or deflates (WriteOnly) gzip
+ * stream of other device on the fly.
+ *
+ * Data pass through in kChunkSize pieces, so a .box.gz file is parsed by
+ * BoxParser or written by BoxSaveJob without an uncompressed copy on disk.
+ * Concatenated gzip members (e.g. from pigz) are read as one stream.
+ */
+class BoxGzip : public QIODevice {
+  public:
+    static const int kChunkSize = 64 * 1024;
+
+    explicit BoxGzip(QIODevice* device, QObject* parent = 0);
+    ~BoxGzip();
+
+    /** Box files with .gz suffix are compressed. */
+    static bool isGzipFile(const QString& fileName);
+
+    /** Open for reading or for writing (not both). */
+    bool open(OpenMode mode);
+    /** Write rest of compressed stream, false on error. */
+    bool finish();
+    void close();
+    bool isSequential() const {
+        return true;
+    }
+
+  protected:
+    qint64 readData(char* data, qint64 maxSize);
+    qint64 writeData(const char* data, qint64 size);
+
+  private:
+    bool deflateTo(int flush);
+    void setZlibError(int result);
+
+    QIODevice* m_device;
+    z_stream_s* m_stream;
+    QByteArray m_buffer;  /**< compressed data */
+    bool m_end;           /**< whole stream was read/written */
+
+    Q_DISABLE_COPY(BoxGzip)
+};
+
+#endif  // SRC_BOXGZIP_H_
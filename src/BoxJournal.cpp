@@ -0,0 +1,170 @@
+/**********************************************************************
+* File:        BoxJournal.cpp
+* Description: Append-only journal of box edits
+* Author:      qt-box-editor contributors
+* Created:     2026-10-16
+*
+* (C) Copyright 2026, qt-box-editor contributors
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**    http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*
+**********************************************************************/
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QFileInfo>
+
+#include "BoxJournal.h"
+
+static const quint32 kJournalMagic = 0x5142454a;  // "QBEJ"
+static const quint32 kJournalVersion = 1;
+// magic, version, box file size and modification time
+static const qint64 kHeaderSize = 4 + 4 + 8 + 8;
+
+static qint64 boxFileTime(const QFileInfo& info) {
+  return info.exists() ? info.lastModified().toMSecsSinceEpoch() : -1;
+}
+
+QString BoxJournal::journalFileName(const QString& boxFile) {
+  return boxFile + ".journal";
+}
+
+bool BoxJournal::open(const QString& boxFile,
+                      QVector<BoxJournal::Record>* records) {
+  m_file.close();
+  m_boxFile = boxFile;
+  m_last = Record();
+  records->clear();
+
+  QString fileName = journalFileName(boxFile);
+  if (!QFile::exists(fileName))
+    return true;
+
+  QFile file(fileName);
+  if (!file.open(QFile::ReadOnly))
+    return false;
+  QDataStream in(&file);
+  in.setVersion(QDataStream::Qt_4_6);
+
+  quint32 magic, version;
+  qint64 size, time;
+  in >> magic >> version >> size >> time;
+  QFileInfo info(boxFile);
+  if (in.status() != QDataStream::Ok || magic != kJournalMagic ||
+      version != kJournalVersion || size != info.size() ||
+      time != boxFileTime(info)) {
+    // Journal of other version of box file
+    file.close();
+    QFile::remove(fileName);
+    return true;
+  }
+
+  // The last record could be torn by crash - stop at first broken one
+  qint64 valid = file.pos();
+  while (!in.atEnd()) {
+    quint8 op;
+    qint32 page, row;
+    QByteArray line;
+    in >> op >> page >> row >> line;
+    if (in.status() != QDataStream::Ok || op < SetRow || op > RemoveRow)
+      break;
+    Record record;
+    record.op = static_cast<Operation>(op);
+    record.page = page;
+    record.row = row;
+    record.line = line;
+    records->append(record);
+    valid = file.pos();
+  }
+  file.close();
+
+  m_file.setFileName(fileName);
+  if (!m_file.open(QFile::ReadWrite) || !m_file.resize(valid) ||
+      !m_file.seek(valid)) {
+    m_file.close();
+    return false;
+  }
+  return true;
+}
+
+void BoxJournal::append(Operation op, int page, int row,
+                        const QByteArray& line) {
+  if (m_boxFile.isEmpty())
+    return;
+  if (op == SetRow && m_last.op == SetRow && m_last.page == page &&
+      m_last.row == row && m_last.line == line)
+    return;
+  if (!m_file.isOpen() && !create())
+    return;
+
+  QByteArray record;
+  QDataStream out(&record, QIODevice::WriteOnly);
+  out.setVersion(QDataStream::Qt_4_6);
+  out << static_cast<quint8>(op) << static_cast<qint32>(page)
+      << static_cast<qint32>(row) << line;
+  m_file.write(record);
+  m_file.flush();
+
+  m_last.op = op;
+  m_last.page = page;
+  m_last.row = row;
+  m_last.line = line;
+}
+
+void BoxJournal::discard() {
+  m_last = Record();
+  if (m_boxFile.isEmpty())
+    return;
+  m_file.close();
+  QFile::remove(journalFileName(m_boxFile));
+}
+
+bool BoxJournal::isEmpty() const {
+  return !m_file.isOpen() || m_file.size() <= kHeaderSize;
+}
+
+qint64 BoxJournal::position() const {
+  return m_file.isOpen() ? m_file.size() : kHeaderSize;
+}
+
+void BoxJournal::compact(qint64 position) {
+  if (!m_file.isOpen())
+    return;
+  QByteArray tail;
+  if (m_file.seek(position))
+    tail = m_file.readAll();
+  m_file.close();
+  if (tail.isEmpty()) {
+    discard();
+    return;
+  }
+  if (create()) {
+    m_file.write(tail);
+    m_file.flush();
+  }
+}
+
+bool BoxJournal::create() {
+  m_file.close();
+  m_file.setFileName(journalFileName(m_boxFile));
+  if (!m_file.open(QFile::ReadWrite | QFile::Truncate))
+    return false;
+
+  QFileInfo info(m_boxFile);
+  QDataStream out(&m_file);
+  out.setVersion(QDataStream::Qt_4_6);
+  out << kJournalMagic << kJournalVersion << info.size()
+      << boxFileTime(info);
+  m_file.flush();
+  return true;
+}
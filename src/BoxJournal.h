@@ -0,0 +1,88 @@
+/**********************************************************************
+* File:        BoxJournal.h
+* Description: Append-only journal of box edits
+* Author:      qt-box-editor contributors
+* Created:     2026-10-16
+*
+* (C) Copyright 2026, qt-box-editor contributors
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**    http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*
+**********************************************************************/
+
+#ifndef SRC_BOXJOURNAL_H_
+#define SRC_BOXJOURNAL_H_
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <QVector>
+
+/**
+ * Binary journal (<box file>.journal) of row edits made since the box
+ * file was last saved.
+ *
+ * Every edit is one small record appended (and flushed) to the journal, so
+ * unsaved work survives a crash at cost of a few bytes per edit. The
+ * journal header holds size and modification time of the box file it
+ * applies to; a journal of other version of the box file is ignored.
+ */
+class BoxJournal {
+  public:
+    enum Operation {
+        SetRow = 1,
+        InsertRow = 2,
+        RemoveRow = 3
+    };
+
+    struct Record {
+        Record() : op(SetRow), page(-1), row(-1) {}
+
+        Operation op;
+        int page;
+        int row;
+        QByteArray line;  /**< formatted box line, empty for RemoveRow */
+    };
+
+    static QString journalFileName(const QString& boxFile);
+
+    /**
+     * Attach journal to boxFile. Records of valid journal left from
+     * previous session are returned in records and further edits are
+     * appended to them.
+     */
+    bool open(const QString& boxFile, QVector<Record>* records);
+    void append(Operation op, int page, int row,
+                const QByteArray& line = QByteArray());
+    /** Drop journal (changes were saved or thrown away). */
+    void discard();
+
+    /** True if journal holds no edits. */
+    bool isEmpty() const;
+    /** Current end of journal, see compact(). */
+    qint64 position() const;
+    /**
+     * Box file was saved with all edits before position. Drop their
+     * records and rebase journal to the saved file.
+     */
+    void compact(qint64 position);
+
+  private:
+    bool create();
+
+    QString m_boxFile;
+    QFile m_file;
+    Record m_last;  /**< to skip repeated SetRow of the same row */
+};
+
+#endif  // SRC_BOXJOURNAL_H_
@@ -0,0 +1,433 @@
+/**********************************************************************
+* File:        BoxLayer.cpp
+* Description: Graphics item painting all boxes of page
+* Author:      qt-box-editor contributors
+* Created:     2026-10-16
+*
+* (C) Copyright 2026, qt-box-editor contributors
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**    http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*
+**********************************************************************/
+
+#include <math.h>
+
+#include <QtAlgorithms>
+
+#include <QGraphicsSceneHoverEvent>
+#include <QPainter>
+#include <QPen>
+#include <QStyleOptionGraphicsItem>
+
+#include "BoxLayer.h"
+
+// Area covered by box (inverted boxes are normalized)
+static QRectF area(const QRect& box) {
+  return QRectF(box).normalized();
+}
+
+// Rectangles intersect or touch each other
+static bool touches(const QRectF& a, const QRectF& b) {
+  return a.left() <= b.right() && a.right() >= b.left() &&
+         a.top() <= b.bottom() && a.bottom() >= b.top();
+}
+
+// Rectangle a lies in b (unlike QRectF::contains() also if a is empty)
+static bool inside(const QRectF& a, const QRectF& b) {
+  return a.left() >= b.left() && a.right() <= b.right() &&
+         a.top() >= b.top() && a.bottom() <= b.bottom();
+}
+
+// Smallest rectangle containing both a and b (empty ones too)
+static QRectF unite(const QRectF& a, const QRectF& b) {
+  return QRectF(QPointF(qMin(a.left(), b.left()), qMin(a.top(), b.top())),
+                QPointF(qMax(a.right(), b.right()),
+                        qMax(a.bottom(), b.bottom())));
+}
+
+static int cellOf(qreal value, qreal origin, int cellSize) {
+  return static_cast<int>(floor((value - origin) / cellSize));
+}
+
+BoxLayer::BoxLayer(QGraphicsItem* parent)
+  : QGraphicsItem(parent),
+    m_hovered(-1),
+    m_boxesVisible(false),
+    m_hasBounds(false),
+    m_cellSize(kCellSize),
+    m_gridColumns(0),
+    m_gridRows(0),
+    m_rowsValid(0),
+    m_indexDirty(false),
+    m_stamp(0) {
+  // exposedRect is needed to paint only part of boxes
+  setFlag(QGraphicsItem::ItemUsesExtendedStyleOption, true);
+  setAcceptHoverEvents(true);
+  setAcceptedMouseButtons(Qt::NoButton);
+  setZValue(2);
+}
+
+void BoxLayer::setColors(const QColor& box, const QColor& selected,
+                         const QColor& hover) {
+  m_boxColor = box;
+  m_selectedColor = selected;
+  m_hoverColor = hover;
+  update();
+}
+
+void BoxLayer::setBoxesVisible(bool visible) {
+  if (m_boxesVisible == visible)
+    return;
+  m_boxesVisible = visible;
+  update();
+}
+
+void BoxLayer::clear() {
+  prepareGeometryChange();
+  m_boxes.clear();
+  m_state.clear();
+  m_hovered = -1;
+  m_preview.clear();
+  m_bounds = QRectF();
+  m_hasBounds = false;
+  m_cells.clear();
+  m_gridArea = QRectF();
+  m_gridColumns = 0;
+  m_gridRows = 0;
+  m_ids.clear();
+  m_rowOfId.clear();
+  m_rowsValid = 0;
+  m_freeIds.clear();
+  m_indexDirty = false;
+  m_mark.clear();
+}
+
+void BoxLayer::insertBoxes(int row, const QVector<QRect>& boxes) {
+  if (boxes.isEmpty())
+    return;
+  setPreview(QVector<int>());
+  m_boxes.insert(row, boxes.size(), QRect());
+  m_state.insert(row, boxes.size(), 0);
+  m_ids.insert(row, boxes.size(), -1);  // id is given when indexed
+  m_rowsValid = qMin(m_rowsValid, row);
+  for (int i = 0; i < boxes.size(); ++i) {
+    m_boxes[row + i] = boxes.at(i);
+    growBounds(boxes.at(i));
+  }
+  if (m_hovered >= row)
+    m_hovered += boxes.size();
+  // Page (or any bulk insert) is indexed at once on next query
+  if (boxes.size() == 1 && !m_indexDirty) {
+    m_ids[row] = newId();
+    indexBox(row);
+  } else {
+    m_indexDirty = true;
+  }
+
+  // Whole page is inserted at once, do not schedule update per box
+  if (boxes.size() == 1)
+    updateBox(row);
+  else
+    update();
+}
+
+void BoxLayer::removeBoxes(int row, int count) {
+  if (count < 1)
+    return;
+  // rows of preview are not valid any more
+  setPreview(QVector<int>());
+  for (int i = row; i < row + count; ++i) {
+    updateBox(i);
+    if (!m_indexDirty) {
+      unindexBox(i);
+      m_freeIds.append(m_ids.at(i));
+    }
+  }
+  if (m_hovered >= row + count)
+    m_hovered -= count;
+  else if (m_hovered >= row)
+    m_hovered = -1;
+  m_boxes.remove(row, count);
+  m_state.remove(row, count);
+  m_ids.remove(row, count);
+  m_rowsValid = qMin(m_rowsValid, row);
+}
+
+void BoxLayer::setBox(int row, const QRect& rect) {
+  if (m_boxes.at(row) == rect)
+    return;
+  updateBox(row);
+  if (!m_indexDirty)
+    unindexBox(row);
+  m_boxes[row] = rect;
+  growBounds(rect);
+  if (!m_indexDirty)
+    indexBox(row);
+  updateBox(row);
+}
+
+void BoxLayer::setBoxSelected(int row, bool selected) {
+  setState(row, Selected, selected);
+}
+
+void BoxLayer::clearSelection() {
+  for (int row = 0; row < m_state.size(); ++row)
+    setState(row, Selected, false);
+}
+
+void BoxLayer::setState(int row, int state, bool on) {
+  quint8 old = m_state.at(row);
+  quint8 changed = on ? (old | state) : (old & ~state);
+  if (changed == old)
+    return;
+  m_state[row] = changed;
+  updateBox(row);
+}
+
+void BoxLayer::setHovered(int row) {
+  if (row == m_hovered)
+    return;
+  if (m_hovered >= 0)
+    setState(m_hovered, Hovered, false);
+  m_hovered = row;
+  if (m_hovered >= 0)
+    setState(m_hovered, Hovered, true);
+}
+
+void BoxLayer::updateBox(int row) {
+  // pen is painted half outside of box
+  update(area(m_boxes.at(row)).adjusted(-1, -1, 1, 1));
+}
+
+void BoxLayer::growBounds(const QRect& box) {
+  QRectF rect = area(box);
+  if (m_hasBounds && inside(rect, m_bounds))
+    return;
+  prepareGeometryChange();
+  m_bounds = m_hasBounds ? unite(m_bounds, rect) : rect;
+  m_hasBounds = true;
+}
+
+QRect BoxLayer::cellRange(const QRectF& rect) const {
+  if (m_gridColumns == 0)
+    return QRect();
+  qreal left = m_gridArea.left();
+  qreal top = m_gridArea.top();
+  int x0 = cellOf(rect.left(), left, m_cellSize);
+  int y0 = cellOf(rect.top(), top, m_cellSize);
+  int x1 = cellOf(rect.right(), left, m_cellSize);
+  int y1 = cellOf(rect.bottom(), top, m_cellSize);
+  if (x1 < 0 || y1 < 0 || x0 >= m_gridColumns || y0 >= m_gridRows)
+    return QRect();
+  return QRect(QPoint(qMax(x0, 0), qMax(y0, 0)),
+               QPoint(qMin(x1, m_gridColumns - 1), qMin(y1, m_gridRows - 1)));
+}
+
+void BoxLayer::buildIndex() {
+  m_indexDirty = false;
+  // ids are rows again
+  int count = m_boxes.size();
+  m_ids.resize(count);
+  m_rowOfId.resize(count);
+  for (int row = 0; row < count; ++row) {
+    m_ids[row] = row;
+    m_rowOfId[row] = row;
+  }
+  m_rowsValid = count;
+  m_freeIds.clear();
+  m_cells.clear();
+  m_gridArea = QRectF();
+  m_gridColumns = 0;
+  m_gridRows = 0;
+  if (m_boxes.isEmpty())
+    return;
+
+  m_cellSize = kCellSize;
+  while (true) {
+    m_gridColumns = cellOf(m_bounds.right(), m_bounds.left(), m_cellSize) + 1;
+    m_gridRows = cellOf(m_bounds.bottom(), m_bounds.top(), m_cellSize) + 1;
+    if (static_cast<qint64>(m_gridColumns) * m_gridRows <= kMaxCells)
+      break;
+    m_cellSize *= 2;
+  }
+  m_cells.resize(m_gridColumns * m_gridRows);
+  m_gridArea = QRectF(m_bounds.topLeft(),
+                      QSizeF(m_gridColumns * m_cellSize,
+                             m_gridRows * m_cellSize));
+  for (int row = 0; row < m_boxes.size(); ++row)
+    indexBox(row);
+}
+
+void BoxLayer::indexBox(int row) {
+  QRectF rect = area(m_boxes.at(row));
+  // Box out of grid needs new grid
+  if (m_gridColumns == 0 || !inside(rect, m_gridArea)) {
+    m_indexDirty = true;
+    return;
+  }
+  QRect cells = cellRange(rect);
+  for (int y = cells.top(); y <= cells.bottom(); ++y)
+    for (int x = cells.left(); x <= cells.right(); ++x)
+      m_cells[y * m_gridColumns + x].append(m_ids.at(row));
+}
+
+void BoxLayer::unindexBox(int row) {
+  int id = m_ids.at(row);
+  QRect cells = cellRange(area(m_boxes.at(row)));
+  for (int y = cells.top(); y <= cells.bottom(); ++y) {
+    for (int x = cells.left(); x <= cells.right(); ++x) {
+      QVector<int>& cell = m_cells[y * m_gridColumns + x];
+      int i = cell.indexOf(id);
+      if (i >= 0)
+        cell.remove(i);
+    }
+  }
+}
+
+// Id of removed box is reused, so id range stays close to row count
+int BoxLayer::newId() {
+  if (!m_freeIds.isEmpty()) {
+    int id = m_freeIds.last();
+    m_freeIds.remove(m_freeIds.size() - 1);
+    return id;
+  }
+  m_rowOfId.append(-1);  // set by syncRows()
+  return m_rowOfId.size() - 1;
+}
+
+// Rows from m_rowsValid on were shifted by insert/remove since last query.
+// It is done once per query, not per edit, and touches no cell.
+void BoxLayer::syncRows() {
+  for (int row = m_rowsValid; row < m_ids.size(); ++row)
+    m_rowOfId[m_ids.at(row)] = row;
+  m_rowsValid = m_ids.size();
+}
+
+QVector<int> BoxLayer::boxesIn(const QRectF& rect) {
+  QVector<int> rows;
+  if (m_indexDirty)
+    buildIndex();
+  syncRows();
+  QRect cells = cellRange(rect);
+  if (cells.isEmpty())
+    return rows;
+
+  // Box in more cells is reported once, ids are marked by query stamp
+  if (m_mark.size() < m_rowOfId.size())
+    m_mark.fill(0, qMax(m_rowOfId.size(), 2 * m_mark.size()));
+  if (++m_stamp == 0) {
+    m_mark.fill(0);
+    m_stamp = 1;
+  }
+  for (int y = cells.top(); y <= cells.bottom(); ++y) {
+    for (int x = cells.left(); x <= cells.right(); ++x) {
+      const QVector<int>& cell = m_cells.at(y * m_gridColumns + x);
+      for (int i = 0; i < cell.size(); ++i) {
+        int id = cell.at(i);
+        if (m_mark.at(id) == m_stamp)
+          continue;
+        m_mark[id] = m_stamp;
+        int row = m_rowOfId.at(id);
+        if (touches(area(m_boxes.at(row)), rect))
+          rows.append(row);
+      }
+    }
+  }
+  return rows;
+}
+
+QVector<int> BoxLayer::boxesCenteredIn(const QRectF& rect) {
+  QVector<int> candidates = boxesIn(rect);
+  QVector<int> rows;
+  rows.reserve(candidates.size());
+  for (int i = 0; i < candidates.size(); ++i) {
+    const QRect& box = m_boxes.at(candidates.at(i));
+    // same (integer) center as table coordinates give
+    int cx = (2 * box.x() + box.width()) / 2;
+    int cy = (2 * box.y() + box.height()) / 2;
+    if (cx >= rect.left() && cx <= rect.right() &&
+        cy >= rect.top() && cy <= rect.bottom())
+      rows.append(candidates.at(i));
+  }
+  qSort(rows);
+  return rows;
+}
+
+void BoxLayer::setPreview(const QVector<int>& rows) {
+  for (int i = 0; i < m_preview.size(); ++i)
+    setState(m_preview.at(i), Preview, false);
+  m_preview = rows;
+  for (int i = 0; i < m_preview.size(); ++i)
+    setState(m_preview.at(i), Preview, true);
+}
+
+int BoxLayer::boxAt(const QPointF& pos) {
+  QVector<int> rows = boxesIn(QRectF(pos, QSizeF(0, 0)));
+  int found = -1;
+  qreal foundArea = 0;
+  for (int i = 0; i < rows.size(); ++i) {
+    QRectF rect = area(m_boxes.at(rows.at(i)));
+    qreal boxArea = rect.width() * rect.height();
+    if (found < 0 || boxArea < foundArea ||
+        (boxArea == foundArea && rows.at(i) < found)) {
+      found = rows.at(i);
+      foundArea = boxArea;
+    }
+  }
+  return found;
+}
+
+QRectF BoxLayer::boundingRect() const {
+  return m_bounds.adjusted(-1, -1, 1, 1);
+}
+
+void BoxLayer::paint(QPainter* painter, const QStyleOptionGraphicsItem* option,
+                     QWidget* /*widget*/) {
+  QVector<int> rows = boxesIn(option->exposedRect.adjusted(-1, -1, 1, 1));
+
+  // hover fill, then boxes, previewed and selected boxes on top
+  for (int i = 0; i < rows.size(); ++i) {
+    int row = rows.at(i);
+    if (m_state.at(row) & Hovered)
+      painter->fillRect(QRectF(m_boxes.at(row)), m_hoverColor);
+  }
+  painter->setBrush(Qt::NoBrush);
+  if (m_boxesVisible) {
+    painter->setPen(QPen(m_boxColor));
+    for (int i = 0; i < rows.size(); ++i) {
+      int row = rows.at(i);
+      if (!(m_state.at(row) & Selected))
+        painter->drawRect(QRectF(m_boxes.at(row)));
+    }
+  }
+  painter->setPen(QPen(m_selectedColor, 0, Qt::DashLine));
+  for (int i = 0; i < rows.size(); ++i) {
+    int row = rows.at(i);
+    if ((m_state.at(row) & (Selected | Preview)) == Preview)
+      painter->drawRect(QRectF(m_boxes.at(row)));
+  }
+  painter->setPen(QPen(m_selectedColor));
+  for (int i = 0; i < rows.size(); ++i) {
+    int row = rows.at(i);
+    if (m_state.at(row) & Selected)
+      painter->drawRect(QRectF(m_boxes.at(row)));
+  }
+}
+
+void BoxLayer::hoverMoveEvent(QGraphicsSceneHoverEvent* event) {
+  setHovered(boxAt(event->pos()));
+}
+
+void BoxLayer::hoverLeaveEvent(QGraphicsSceneHoverEvent* /*event*/) {
+  setHovered(-1);
+}
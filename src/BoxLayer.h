@@ -0,0 +1,142 @@
+/**********************************************************************
+* File:        BoxLayer.h
+* Description: Graphics item painting all boxes of page
+* Author:      qt-box-editor contributors
+* Created:     2026-10-16
+*
+* (C) Copyright 2026, qt-box-editor contributors
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**    http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*
+**********************************************************************/
+
+#ifndef SRC_BOXLAYER_H_
+#define SRC_BOXLAYER_H_
+
+#include <QColor>
+#include <QGraphicsItem>
+#include <QRect>
+#include <QRectF>
+#include <QVector>
+
+/**
+ * All boxes of page painted by one graphics item.
+ *
+ * Boxes are kept in row order of the table (scene coordinates) with one
+ * state byte per box. A uniform grid of cells over the boxes is used to
+ * find boxes intersecting exposed (or queried) area, so neither painting
+ * nor hit testing has to walk all boxes of a big page. Cells hold stable
+ * ids of boxes, not rows, so single box edits (insert and remove too)
+ * update only cells of that box; grid is rebuilt only after bulk changes
+ * or if a box leaves the area of grid.
+ *
+ * Not selected boxes are painted only if boxes are shown, selected boxes
+ * always. Box under mouse cursor is filled, boxes previewed for selection
+ * (by rubber band) are dashed.
+ */
+class BoxLayer : public QGraphicsItem {
+  public:
+    enum State {
+        Selected = 0x1,
+        Hovered = 0x2,
+        Preview = 0x4
+    };
+    /** Cell size of grid, it grows if boxes spread over a huge area. */
+    static const int kCellSize = 64;
+    static const int kMaxCells = 64 * 1024;
+
+    explicit BoxLayer(QGraphicsItem* parent = 0);
+
+    void setColors(const QColor& box, const QColor& selected,
+                   const QColor& hover);
+    void setBoxesVisible(bool visible);
+    bool boxesVisible() const {
+        return m_boxesVisible;
+    }
+
+    int count() const {
+        return m_boxes.size();
+    }
+    QRect box(int row) const {
+        return m_boxes.at(row);
+    }
+    void clear();
+    /** Insert boxes before row (rows from row on are shifted). */
+    void insertBoxes(int row, const QVector<QRect>& boxes);
+    void removeBoxes(int row, int count);
+    void setBox(int row, const QRect& rect);
+
+    bool isBoxSelected(int row) const {
+        return m_state.at(row) & Selected;
+    }
+    void setBoxSelected(int row, bool selected);
+    void clearSelection();
+
+    /** Rows of boxes intersecting rect, in no particular order. */
+    QVector<int> boxesIn(const QRectF& rect);
+    /** Sorted rows of boxes with center in rect (rubber band selection). */
+    QVector<int> boxesCenteredIn(const QRectF& rect);
+    /** Mark rows as previewed (previous preview is cleared). */
+    void setPreview(const QVector<int>& rows);
+    /**
+     * Row of a box containing pos, -1 if there is none. The smallest box
+     * wins if boxes overlap (e.g. letter inside of a word box).
+     */
+    int boxAt(const QPointF& pos);
+
+    QRectF boundingRect() const;
+    void paint(QPainter* painter, const QStyleOptionGraphicsItem* option,
+               QWidget* widget = 0);
+
+  protected:
+    void hoverMoveEvent(QGraphicsSceneHoverEvent* event);
+    void hoverLeaveEvent(QGraphicsSceneHoverEvent* event);
+
+  private:
+    void setState(int row, int state, bool on);
+    void setHovered(int row);
+    void updateBox(int row);
+    void growBounds(const QRect& box);
+    void buildIndex();
+    QRect cellRange(const QRectF& rect) const;
+    void indexBox(int row);
+    void unindexBox(int row);
+    int newId();
+    void syncRows();
+
+    QVector<QRect> m_boxes;
+    QVector<quint8> m_state;  /**< State bits of every box */
+    int m_hovered;            /**< row of hovered box, -1 if none */
+    QVector<int> m_preview;   /**< rows of previewed boxes */
+    bool m_boxesVisible;
+    QColor m_boxColor;
+    QColor m_selectedColor;
+    QColor m_hoverColor;
+
+    QRectF m_bounds;  /**< union of all boxes (never shrinks) */
+    bool m_hasBounds;
+    QVector<QVector<int> > m_cells;  /**< ids of boxes in every cell */
+    QVector<int> m_ids;       /**< id of box in every row */
+    QVector<int> m_rowOfId;   /**< row of every id in use */
+    int m_rowsValid;          /**< m_rowOfId is valid for rows before */
+    QVector<int> m_freeIds;   /**< ids of removed boxes */
+    QRectF m_gridArea;  /**< area covered by cells */
+    int m_cellSize;
+    int m_gridColumns;
+    int m_gridRows;
+    bool m_indexDirty;
+    QVector<int> m_mark;  /**< query stamp of every id, see boxesIn() */
+    int m_stamp;
+};
+
+#endif  // SRC_BOXLAYER_H_
@@ -0,0 +1,409 @@
+/**********************************************************************
+* File:        BoxParser.cpp
+* Description: Streaming tokenizer for tesseract box files
+* Author:      qt-box-editor contributors
+* Created:     2026-10-16
+*
+* (C) Copyright 2026, qt-box-editor contributors
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**    http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*
+**********************************************************************/
+
+#include <string.h>
+
+#include <QRunnable>
+#include <QThreadPool>
+
+#include "BoxParser.h"
+
+static const int kMaxFields = BoxParser::kMaxFields;
+static const char kWordStr[] = "WordStr ";
+static const int kWordStrLength = 8;
+// Smaller data are not worth of starting threads
+static const qint64 kParallelMinSize = 4 * 1024 * 1024;
+// Chunks per thread - smooths out chunks with different line lengths
+static const int kChunksPerThread = 4;
+
+// Indexes one chunk of mapped data in a thread of pool
+class BoxChunkTask : public QRunnable {
+  public:
+    BoxChunkTask(const char* base, const char* begin, const char* end,
+                 bool rangesOnly)
+      : parser(&pages), ok(false), m_begin(begin), m_end(end) {
+      if (rangesOnly)
+        parser.m_ranges = &ranges;
+      parser.m_base = base;
+      // only the first chunk can start with BOM
+      parser.m_started = (begin != base);
+      setAutoDelete(false);
+    }
+
+    void run() {
+      ok = parser.parseRange(m_begin, m_end);
+      if (ok)
+        parser.closePage();
+    }
+
+    QVector<QVector<BoxRow> > pages;
+    QVector<BoxPageRange> ranges;
+    BoxParser parser;
+    bool ok;
+
+  private:
+    const char* m_begin;
+    const char* m_end;
+};
+
+// Split line on every single space (empty fields count, same as
+// QString::split(" ")) without copying anything. Returns number of fields.
+static int splitFields(const char* begin, const char* end,
+                       const char** field, int* fieldLength) {
+  int count = 0;
+  const char* start = begin;
+  while (true) {
+    const char* space =
+      static_cast<const char*>(memchr(start, ' ', end - start));
+    const char* stop = space ? space : end;
+    if (count < kMaxFields) {
+      field[count] = start;
+      fieldLength[count] = static_cast<int>(stop - start);
+    }
+    ++count;
+    if (!space)
+      break;
+    start = space + 1;
+  }
+  return count;
+}
+
+BoxParser::BoxParser(QVector<QVector<BoxRow> >* pages)
+  : m_pages(pages),
+    m_ranges(0),
+    m_columns(0),
+    m_store(0),
+    m_base(0),
+    m_pagePrev(0),
+    m_line(0),
+    m_errorLine(0),
+    m_errorFields(0),
+    m_started(false),
+    m_wordStr(false) {
+}
+
+BoxParser::BoxParser(QVector<BoxPageRange>* ranges)
+  : m_pages(0),
+    m_ranges(ranges),
+    m_columns(0),
+    m_store(0),
+    m_base(0),
+    m_pagePrev(0),
+    m_line(0),
+    m_errorLine(0),
+    m_errorFields(0),
+    m_started(false),
+    m_wordStr(false) {
+}
+
+BoxParser::BoxParser(QVector<BoxColumns>* pages, BoxStore* store)
+  : m_pages(0),
+    m_ranges(0),
+    m_columns(pages),
+    m_store(store),
+    m_base(0),
+    m_pagePrev(0),
+    m_line(0),
+    m_errorLine(0),
+    m_errorFields(0),
+    m_started(false),
+    m_wordStr(false) {
+}
+
+bool BoxParser::parse(QIODevice* device) {
+  QByteArray chunk;
+  chunk.resize(kChunkSize);
+
+  while (true) {
+    qint64 read = device->read(chunk.data(), kChunkSize);
+    if (read < 0)
+      return false;  // I/O error, errorLine() stays 0
+    if (read == 0)
+      break;
+    if (!feed(chunk.constData(), static_cast<int>(read)))
+      return false;
+  }
+  return finish();
+}
+
+bool BoxParser::parse(const char* data, qint64 size) {
+  m_base = data;
+  if (!parseRange(data, data + size))
+    return false;
+  closePage();
+  return true;
+}
+
+bool BoxParser::parse(const char* data, qint64 size, int threads) {
+  // Columns share glyph table, they are decoded in one thread
+  if (threads < 2 || size < kParallelMinSize || m_columns)
+    return parse(data, size);
+
+  // Cut data to chunks, every chunk ends right after a newline
+  QList<BoxChunkTask*> tasks;
+  const char* end = data + size;
+  const char* begin = data;
+  int chunks = threads * kChunksPerThread;
+  for (int i = 1; i <= chunks && begin < end; ++i) {
+    const char* stop = data + size * i / chunks;
+    if (stop < begin)
+      stop = begin;
+    if (stop < end) {
+      const char* newline =
+        static_cast<const char*>(memchr(stop, '\n', end - stop));
+      stop = newline ? newline + 1 : end;
+    }
+    tasks.append(new BoxChunkTask(data, begin, stop, m_ranges != 0));
+    begin = stop;
+  }
+
+  QThreadPool pool;
+  pool.setMaxThreadCount(threads);
+  for (int i = 0; i < tasks.size(); ++i)
+    pool.start(tasks[i]);
+  pool.waitForDone();
+
+  // Stitch chunks in order. Every chunk starts its own run of pages, so
+  // a page that continues over chunk edge is merged here.
+  m_base = data;
+  bool ok = true;
+  for (int i = 0; i < tasks.size(); ++i) {
+    BoxChunkTask* task = tasks[i];
+    if (ok && !task->ok) {
+      m_errorLine = m_line + task->parser.errorLine();
+      m_errorFields = task->parser.errorFieldCount();
+      ok = false;
+    }
+    if (ok) {
+      m_line += task->parser.m_line;
+      m_wordStr = m_wordStr || task->parser.m_wordStr;
+      for (int p = 0; p < task->parser.m_numbers.size(); ++p) {
+        bool empty = m_ranges ? task->ranges.at(p).rows == 0
+                              : task->pages.at(p).isEmpty();
+        if (empty)
+          continue;  // leading empty page of chunk
+        int number = task->parser.m_numbers.at(p);
+        if (number != m_pagePrev) {
+          closePage();
+          m_pagePrev = number;
+        }
+        if (m_ranges) {
+          const BoxPageRange& range = task->ranges.at(p);
+          if (m_range.rows == 0)
+            m_range.begin = range.begin;
+          m_range.end = range.end;
+          m_range.rows += range.rows;
+        } else {
+          m_page += task->pages.at(p);
+        }
+      }
+    }
+    delete task;
+  }
+  if (!ok)
+    return false;
+  closePage();
+  return true;
+}
+
+bool BoxParser::parseRange(const char* begin, const char* end) {
+  const char* pos = begin;
+
+  while (pos < end) {
+    const char* newline =
+      static_cast<const char*>(memchr(pos, '\n', end - pos));
+    const char* stop = newline ? newline : end;
+    if (!parseLine(pos, stop))
+      return false;
+    pos = stop + 1;
+  }
+  return true;
+}
+
+void BoxParser::closePage() {
+  if (m_ranges) {
+    m_ranges->append(m_range);
+    m_range = BoxPageRange();
+  } else if (m_columns) {
+    m_columns->append(m_columnPage);
+    m_columnPage.clear();
+  } else {
+    m_pages->append(m_page);
+    m_page.clear();
+  }
+  m_numbers.append(m_pagePrev);
+}
+
+bool BoxParser::feed(const char* data, int size) {
+  const char* pos = data;
+  const char* end = data + size;
+
+  while (pos < end) {
+    const char* newline =
+      static_cast<const char*>(memchr(pos, '\n', end - pos));
+    if (!newline) {
+      // keep incomplete line for next chunk
+      m_carry.append(pos, static_cast<int>(end - pos));
+      break;
+    }
+    if (m_carry.isEmpty()) {
+      if (!parseLine(pos, newline))
+        return false;
+    } else {
+      m_carry.append(pos, static_cast<int>(newline - pos));
+      if (!parseLine(m_carry.constData(),
+                     m_carry.constData() + m_carry.size()))
+        return false;
+      m_carry.resize(0);
+    }
+    pos = newline + 1;
+  }
+  return true;
+}
+
+bool BoxParser::finish() {
+  if (!m_carry.isEmpty()) {
+    if (!parseLine(m_carry.constData(), m_carry.constData() + m_carry.size()))
+      return false;
+    m_carry.clear();
+  }
+  closePage();
+  return true;
+}
+
+bool BoxParser::parseLine(const char* begin, const char* end) {
+  ++m_line;
+  if (!m_started) {
+    m_started = true;
+    // QTextStream used to skip UTF-8 BOM for us
+    if (end - begin >= 3 && memcmp(begin, "\xEF\xBB\xBF", 3) == 0)
+      begin += 3;
+  }
+  if (end > begin && *(end - 1) == '\r')
+    --end;
+  if (begin == end)
+    return true;  // skip empty lines
+
+  const char* field[kMaxFields];
+  int fieldLength[kMaxFields];
+  int count = splitFields(begin, end, field, fieldLength);
+
+  int first = 0;
+  if (count >= 7 && wordStrText(begin, end)) {
+    m_wordStr = true;  // text of line can contain spaces
+  } else if (count == 7) {
+    if (*begin == ' ')
+      first = 1;  // tess2image generate also box for spaces
+  } else if (count != 6) {
+    m_errorLine = m_line;
+    m_errorFields = count;
+    return false;
+  }
+
+  int page;
+  if (!parseInt(field[first + 5], field[first + 5] + fieldLength[first + 5],
+                &page))
+    page = -1;
+
+  if (page != m_pagePrev) {
+    closePage();
+    m_pagePrev = page;
+  }
+  if (m_ranges) {
+    if (m_range.rows == 0)
+      m_range.begin = begin - m_base;
+    m_range.end = end - m_base;
+    ++m_range.rows;
+  } else if (m_columns) {
+    m_store->appendLine(&m_columnPage, begin, end);
+  } else {
+    m_page.append(BoxRow(begin - m_base, static_cast<int>(end - begin)));
+  }
+  return true;
+}
+
+int BoxParser::fields(const char* begin, const char* end,
+                      const char** field, int* fieldLength) {
+  return splitFields(begin, end, field, fieldLength);
+}
+
+const char* BoxParser::wordStrText(const char* begin, const char* end) {
+  if (end - begin <= kWordStrLength ||
+      memcmp(begin, kWordStr, kWordStrLength) != 0)
+    return 0;
+
+  // skip 5 numbers, text must follow as "#..."
+  const char* pos = begin + kWordStrLength;
+  for (int i = 0; i < 5; ++i) {
+    const char* space =
+      static_cast<const char*>(memchr(pos, ' ', end - pos));
+    if (!space)
+      return 0;
+    pos = space + 1;
+  }
+  if (pos == end || *pos != '#')
+    return 0;
+  return pos + 1;
+}
+
+void BoxParser::indexRows(const char* base, const BoxPageRange& range,
+                          QVector<BoxRow>* rows) {
+  const char* pos = base + range.begin;
+  const char* end = base + range.end;
+
+  rows->reserve(rows->size() + range.rows);
+  while (pos < end) {
+    const char* newline =
+      static_cast<const char*>(memchr(pos, '\n', end - pos));
+    const char* stop = newline ? newline : end;
+    const char* next = stop + 1;
+    if (stop > pos && *(stop - 1) == '\r')
+      --stop;
+    if (stop > pos)
+      rows->append(BoxRow(pos - base, static_cast<int>(stop - pos)));
+    pos = next;
+  }
+}
+
+bool BoxParser::parseInt(const char* begin, const char* end, int* value) {
+  bool negative = false;
+  if (begin < end && (*begin == '-' || *begin == '+')) {
+    negative = (*begin == '-');
+    ++begin;
+  }
+  if (begin == end)
+    return false;
+
+  // -2147483648 is valid, its magnitude does not fit to int
+  const qint64 limit = negative ? Q_INT64_C(2147483648) : Q_INT64_C(2147483647);
+  qint64 result = 0;
+  for (; begin < end; ++begin) {
+    unsigned int digit = static_cast<unsigned char>(*begin) - '0';
+    if (digit > 9)
+      return false;
+    result = result * 10 + digit;
+    if (result > limit)
+      return false;
+  }
+  *value = static_cast<int>(negative ? -result : result);
+  return true;
+}
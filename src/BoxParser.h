@@ -0,0 +1,162 @@
+/**********************************************************************
+* File:        BoxParser.h
+* Description: Streaming tokenizer for tesseract box files
+* Author:      qt-box-editor contributors
+* Created:     2026-10-16
+*
+* (C) Copyright 2026, qt-box-editor contributors
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**    http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*
+**********************************************************************/
+
+#ifndef SRC_BOXPARSER_H_
+#define SRC_BOXPARSER_H_
+
+#include <QByteArray>
+#include <QIODevice>
+#include <QVector>
+
+#include "BoxStore.h"
+
+/**
+ * One line of box file, only a view (offset/length, without newline) into
+ * mapped data. Rows read from a stream or edited in the program are
+ * decoded to BoxColumns instead.
+ */
+struct BoxRow {
+    BoxRow() : offset(0), length(0) {}
+    BoxRow(qint64 o, int l) : offset(o), length(l) {}
+
+    qint64 offset;
+    int length;
+};
+
+/**
+ * Byte range of one page in mapped data (from start of its first row to end
+ * of its last row).
+ */
+struct BoxPageRange {
+    BoxPageRange() : begin(0), end(0), rows(0) {}
+
+    qint64 begin;
+    qint64 end;
+    int rows;
+};
+
+/**
+ * Single pass box file tokenizer.
+ *
+ * Input is split into lines and fields in place, so no intermediate copy
+ * of the whole file (or of a line) is ever built. Parsed boxes are appended
+ * directly to the page vector with the same page-change rules readToVector
+ * always used. Space and newline never appear inside a multi-byte UTF-8
+ * sequence, so tokenizing raw bytes is safe.
+ *
+ * Line-level (LSTM) files with rows "WordStr left bottom right top page
+ * #text" are accepted as well; their text can contain spaces. Such rows
+ * are decoded (see BoxStore) to a box whose letter is the whole text.
+ */
+class BoxParser {
+  public:
+    static const int kChunkSize = 64 * 1024;
+    /**
+     * Line can have at most 7 fields (6 + leading space box), one more
+     * slot is enough to detect too long lines. WordStr line has at least
+     * 7 fields, its text starts in the 7th one.
+     */
+    static const int kMaxFields = 8;
+
+    /** Index mapped data, see parse(data, size). */
+    explicit BoxParser(QVector<QVector<BoxRow> >* pages);
+    /** Decode rows to columns, glyphs are interned in store. */
+    BoxParser(QVector<BoxColumns>* pages, BoxStore* store);
+    /**
+     * Validate mapped data, but collect only byte range of every page.
+     * Rows of page are indexed later by indexRows().
+     */
+    explicit BoxParser(QVector<BoxPageRange>* ranges);
+
+    /**
+     * Parse all data from device (read in kChunkSize pieces). Stream data
+     * can be parsed only to columns.
+     */
+    bool parse(QIODevice* device);
+    /** Index mapped data. Rows are views relative to data. */
+    bool parse(const char* data, qint64 size);
+    /**
+     * Same as parse(data, size), but big data are split on line boundaries
+     * to chunks that are indexed by up to 'threads' threads. Chunks are
+     * stitched back in order with the usual page-change rules.
+     */
+    bool parse(const char* data, qint64 size, int threads);
+    /** Push interface: feed() any number of chunks, then call finish(). */
+    bool feed(const char* data, int size);
+    bool finish();
+
+    /** 1-based line number of the first malformed line (0 = no error). */
+    int errorLine() const {
+        return m_errorLine;
+    }
+    /** Number of fields found on malformed line. */
+    int errorFieldCount() const {
+        return m_errorFields;
+    }
+    /** True if any WordStr row was found. */
+    bool hasWordStr() const {
+        return m_wordStr;
+    }
+
+    /** Start of text of WordStr line (after '#'), 0 for other lines. */
+    static const char* wordStrText(const char* begin, const char* end);
+    /**
+     * Split line on every single space without copying. Up to kMaxFields
+     * fields are stored, number of all fields is returned.
+     */
+    static int fields(const char* begin, const char* end,
+                      const char** field, int* fieldLength);
+    /**
+     * Parse decimal integer, false if range is not a number or does not
+     * fit to int.
+     */
+    static bool parseInt(const char* begin, const char* end, int* value);
+    /** Append views of all (already validated) rows in range to rows. */
+    static void indexRows(const char* base, const BoxPageRange& range,
+                          QVector<BoxRow>* rows);
+
+  private:
+    friend class BoxChunkTask;
+
+    bool parseRange(const char* begin, const char* end);
+    bool parseLine(const char* begin, const char* end);
+    void closePage();
+
+    QVector<QVector<BoxRow> >* m_pages;
+    QVector<BoxPageRange>* m_ranges;  /**< set in page range mode */
+    QVector<BoxColumns>* m_columns;   /**< set in column mode */
+    BoxStore* m_store;
+    BoxColumns m_columnPage;
+    QVector<int> m_numbers;  /**< page number of every closed page */
+    QVector<BoxRow> m_page;
+    BoxPageRange m_range;
+    QByteArray m_carry;   /**< incomplete line from previous chunk */
+    const char* m_base;   /**< start of mapped data, 0 in stream mode */
+    int m_pagePrev;
+    int m_line;
+    int m_errorLine;
+    int m_errorFields;
+    bool m_started;
+    bool m_wordStr;
+};
+
+#endif  // SRC_BOXPARSER_H_
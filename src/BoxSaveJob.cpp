@@ -0,0 +1,248 @@
+/**********************************************************************
+* File:        BoxSaveJob.cpp
+* Description: Serialization and atomic write of box document
+* Author:      qt-box-editor contributors
+* Created:     2026-10-16
+*
+* (C) Copyright 2026, qt-box-editor contributors
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**    http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*
+**********************************************************************/
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <QDir>
+#include <QFileInfo>
+#include <QTemporaryFile>
+
+#include "BoxGzip.h"
+#include "BoxSaveJob.h"
+#include "BoxSerializer.h"
+
+static bool syncFile(int handle) {
+#ifdef Q_OS_WIN
+  return _commit(handle) == 0;
+#else
+  return fsync(handle) == 0;
+#endif
+}
+
+// Rename over existing file in one step
+static bool replaceFile(const QString& from, const QString& to) {
+#ifdef Q_OS_WIN
+  QString nativeFrom = QDir::toNativeSeparators(from);
+  QString nativeTo = QDir::toNativeSeparators(to);
+  return MoveFileExW(reinterpret_cast<const wchar_t*>(nativeFrom.utf16()),
+                     reinterpret_cast<const wchar_t*>(nativeTo.utf16()),
+                     MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+  return ::rename(QFile::encodeName(from).constData(),
+                  QFile::encodeName(to).constData()) == 0;
+#endif
+}
+
+// Make the rename itself durable (not needed with MOVEFILE_WRITE_THROUGH)
+static void syncDirectory(const QString& path) {
+#ifndef Q_OS_WIN
+  int handle = ::open(QFile::encodeName(path).constData(), O_RDONLY);
+  if (handle >= 0) {
+    fsync(handle);
+    ::close(handle);
+  }
+#else
+  Q_UNUSED(path);
+#endif
+}
+
+// Formatted rows are written after every chunk of this size
+static const int kFlushSize = 64 * 1024;
+
+BoxSaveJob::BoxSaveJob(const QString& fileName)
+  : m_fileName(fileName),
+    m_wordStr(false),
+    m_data(0),
+    m_size(0),
+    m_generation(0),
+    m_ownFile(false),
+    m_newFileMode(0666),
+    m_flushed(0),
+    m_ok(false) {
+  setAutoDelete(false);
+#ifndef Q_OS_WIN
+  // Temporary file is owner-only, new file gets mode plain open() would
+  // give it. umask can be read only by setting it, so it is done here
+  // (in GUI thread) and not in thread that runs the job.
+  mode_t mask = umask(0);
+  umask(mask);
+  m_newFileMode = 0666 & ~mask;
+#endif
+}
+
+void BoxSaveJob::run() {
+  m_ok = writeFile();
+  emit finished();
+}
+
+/*
+ * Output is never held in memory as a whole: out is only a buffer of
+ * formatted rows that is written to device after every kFlushSize bytes,
+ * clean pages are written straight from original data.
+ */
+bool BoxSaveJob::serialize(QByteArray* out, QIODevice* device) {
+  m_flushed = 0;
+  out->reserve(2 * kFlushSize);
+
+  // Remember where every row and page lands in the output, so the new
+  // file can serve as backing store of all rows afterwards.
+  m_rebased.resize(m_pages.size());
+  m_rebasedRanges.resize(m_pages.size());
+  for (int p = 0; p < m_pages.size(); ++p) {
+    bool ok = m_clean.at(p) ? splicePage(p, out, device)
+                            : writePage(p, out, device);
+    if (!ok)
+      return false;
+  }
+  return flush(out, device);
+}
+
+BoxPageRange BoxSaveJob::cleanRange(int page) const {
+  if (m_unloaded.at(page))
+    return m_ranges.at(page);
+
+  // Original rows in original order cover contiguous range
+  BoxPageRange range;
+  const QVector<BoxRow>& rows = m_pages.at(page);
+  if (!rows.isEmpty()) {
+    range.begin = rows.first().offset;
+    range.end = rows.last().offset + rows.last().length;
+    range.rows = rows.size();
+  }
+  return range;
+}
+
+bool BoxSaveJob::splicePage(int page, QByteArray* out, QIODevice* device) {
+  BoxPageRange range = cleanRange(page);
+  BoxPageRange& target = m_rebasedRanges[page];
+  target.begin = m_flushed + out->size();
+  target.end = target.begin;
+  if (range.rows == 0)
+    return true;
+
+  // Keep CRLF of the last row too, the rest of page has it anyway
+  qint64 length = range.end - range.begin;
+  if (range.end < m_size && m_data[range.end] == '\r')
+    ++length;
+  qint64 shift = m_flushed + out->size() - range.begin;
+  // Page is passed on as it is, it is not copied to buffer
+  if (!flush(out, device) ||
+      device->write(m_data + range.begin, length) != length)
+    return false;
+  m_flushed += length;
+  out->append('\n');
+
+  target.end = range.end + shift;
+  target.rows = range.rows;
+  if (m_unloaded.at(page))
+    return true;
+  const QVector<BoxRow>& rows = m_pages.at(page);
+  QVector<BoxRow>& rebased = m_rebased[page];
+  rebased.reserve(rows.size());
+  for (int r = 0; r < rows.size(); ++r)
+    rebased.append(BoxRow(rows.at(r).offset + shift, rows.at(r).length));
+  return true;
+}
+
+bool BoxSaveJob::writePage(int page, QByteArray* out, QIODevice* device) {
+  const BoxColumns& columns = m_columns.at(page);
+  QVector<BoxRow>& rebased = m_rebased[page];
+  rebased.reserve(columns.size());
+  qint64 begin = m_flushed + out->size();
+  for (int r = 0; r < columns.size(); ++r) {
+    if (out->size() >= kFlushSize && !flush(out, device))
+      return false;
+    int offset = out->size();
+    BoxSerializer::appendRow(out, columns, r, m_glyphs, m_wordStr);
+    rebased.append(BoxRow(m_flushed + offset, out->size() - offset));
+    out->append('\n');
+  }
+  BoxPageRange& range = m_rebasedRanges[page];
+  range.begin = begin;
+  range.end = columns.size() == 0 ? begin : m_flushed + out->size() - 1;
+  range.rows = columns.size();
+  return true;
+}
+
+// Write buffered rows to device and empty buffer (keeping its capacity)
+bool BoxSaveJob::flush(QByteArray* out, QIODevice* device) {
+  if (out->isEmpty())
+    return true;
+  if (device->write(*out) != out->size())
+    return false;
+  m_flushed += out->size();
+  out->resize(0);
+  return true;
+}
+
+bool BoxSaveJob::writeFile() {
+  QFileInfo info(m_fileName);
+  QTemporaryFile file(info.absolutePath() + "/." + info.fileName() +
+                      ".XXXXXX");
+  if (!file.open()) {
+    m_errorString = file.errorString();
+    return false;
+  }
+  QByteArray buffer;
+  if (BoxGzip::isGzipFile(m_fileName)) {
+    // Compressed on the fly, there is no uncompressed copy on disk or in
+    // memory. Compressed file can not back rows of document.
+    m_ownFile = false;
+    BoxGzip gzip(&file);
+    if (!gzip.open(QIODevice::WriteOnly) || !serialize(&buffer, &gzip) ||
+        !gzip.finish()) {
+      m_errorString = gzip.errorString();
+      return false;
+    }
+  } else if (!serialize(&buffer, &file)) {
+    m_errorString = file.errorString();
+    return false;
+  }
+  if (!file.flush() || !syncFile(file.handle())) {
+    m_errorString = file.errorString();
+    return false;
+  }
+  if (info.exists())
+    file.setPermissions(QFile::permissions(m_fileName));
+#ifndef Q_OS_WIN
+  else
+    fchmod(file.handle(), static_cast<mode_t>(m_newFileMode));
+#endif
+
+  QString tempName = file.fileName();
+  file.close();
+  if (!replaceFile(tempName, m_fileName)) {
+    m_errorString = tr("Cannot replace file by %1").arg(tempName);
+    return false;  // temporary file is removed
+  }
+  file.setAutoRemove(false);
+  syncDirectory(info.absolutePath());
+  return true;
+}
@@ -0,0 +1,103 @@
+/**********************************************************************
+* File:        BoxSaveJob.h
+* Description: Serialization and atomic write of box document
+* Author:      qt-box-editor contributors
+* Created:     2026-10-16
+*
+* (C) Copyright 2026, qt-box-editor contributors
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**    http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*
+**********************************************************************/
+
+#ifndef SRC_BOXSAVEJOB_H_
+#define SRC_BOXSAVEJOB_H_
+
+#include <QObject>
+#include <QRunnable>
+#include <QSharedPointer>
+#include <QString>
+#include <QVector>
+
+#include "BoxDocument.h"
+
+/**
+ * Writes snapshot of BoxDocument (see BoxDocument::saveJob()).
+ *
+ * Job owns everything it reads (pages are implicitly shared, mapping is
+ * shared), so it can run in other thread while pages are edited. Data are
+ * written to a temporary file in target directory, synced to disk and
+ * renamed over the target, so the target is never left half written.
+ *
+ * Pages not changed since the file was read are spliced to the output as
+ * one block of original bytes; only edited pages are formatted from their
+ * columns row by row. Output is written (and deflated for .gz files)
+ * chunk by chunk while pages are formatted, it is never held in memory as
+ * a whole. The document maps the written file afterwards.
+ */
+class BoxSaveJob : public QObject, public QRunnable {
+    Q_OBJECT
+
+  public:
+    explicit BoxSaveJob(const QString& fileName);
+
+    QString fileName() const {
+        return m_fileName;
+    }
+    bool isOk() const {
+        return m_ok;
+    }
+
+    void run();
+
+  signals:
+    /** Emitted from thread that ran the job. */
+    void finished();
+
+  private:
+    friend class BoxDocument;
+
+    bool serialize(QByteArray* out, QIODevice* device);
+    BoxPageRange cleanRange(int page) const;
+    bool splicePage(int page, QByteArray* out, QIODevice* device);
+    bool writePage(int page, QByteArray* out, QIODevice* device);
+    bool flush(QByteArray* out, QIODevice* device);
+    bool writeFile();
+
+    QString m_fileName;
+
+    // snapshot of document
+    QVector<QVector<BoxRow> > m_pages;
+    QVector<bool> m_unloaded;
+    QVector<bool> m_clean;  /**< rows are original rows in original order */
+    QVector<BoxColumns> m_columns;
+    QVector<QByteArray> m_glyphs;
+    bool m_wordStr;
+    QVector<BoxPageRange> m_ranges;
+    QSharedPointer<BoxMapping> m_mapping;
+    QByteArray m_buffer;
+    const char* m_data;
+    qint64 m_size;
+    int m_generation;
+    bool m_ownFile;
+    int m_newFileMode;  /**< mode of new file (0666 without umask) */
+
+    // result
+    qint64 m_flushed;     /**< output already written to device */
+    QVector<QVector<BoxRow> > m_rebased;  /**< rows as views of output */
+    QVector<BoxPageRange> m_rebasedRanges;
+    bool m_ok;
+    QString m_errorString;
+};
+
+#endif  // SRC_BOXSAVEJOB_H_
@@ -0,0 +1,152 @@
+/**********************************************************************
+* File:        BoxSerializer.cpp
+* Description: Fast formatting of box file rows
+* Author:      qt-box-editor contributors
+* Created:     2026-10-16
+*
+* (C) Copyright 2026, qt-box-editor contributors
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**    http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*
+**********************************************************************/
+
+#include <string.h>
+
+#include "BoxSerializer.h"
+
+// Longest int is "-2147483648"
+static const int kMaxIntLength = 11;
+static const char kWordStr[] = "WordStr";
+static const int kWordStrLength = 7;
+
+static const char kDigitPairs[] =
+  "0001020304050607080910111213141516171819"
+  "2021222324252627282930313233343536373839"
+  "4041424344454647484950515253545556575859"
+  "6061626364656667686970717273747576777879"
+  "8081828384858687888990919293949596979899";
+
+QByteArray BoxSerializer::formatRow(const QString& letter, int left,
+                                    int bottom, int right, int top,
+                                    int page) {
+  QByteArray text = letter.toUtf8();
+  QByteArray line;
+  line.resize(text.size() + 5 * (kMaxIntLength + 1));
+  char* out = line.data();
+
+  memcpy(out, text.constData(), text.size());
+  out += text.size();
+  int values[5] = { left, bottom, right, top, page };
+  for (int i = 0; i < 5; ++i) {
+    *out++ = ' ';
+    out = appendInt(out, values[i]);
+  }
+  line.resize(static_cast<int>(out - line.constData()));
+  return line;
+}
+
+QByteArray BoxSerializer::formatWordStr(const QString& text, int left,
+                                        int bottom, int right, int top,
+                                        int page) {
+  QByteArray utf8 = text.toUtf8();
+  QByteArray line;
+  line.resize(kWordStrLength + 5 * (kMaxIntLength + 1) + 2 + utf8.size());
+  char* out = line.data();
+
+  memcpy(out, kWordStr, kWordStrLength);
+  out += kWordStrLength;
+  int values[5] = { left, bottom, right, top, page };
+  for (int i = 0; i < 5; ++i) {
+    *out++ = ' ';
+    out = appendInt(out, values[i]);
+  }
+  *out++ = ' ';
+  *out++ = '#';
+  memcpy(out, utf8.constData(), utf8.size());
+  out += utf8.size();
+  line.resize(static_cast<int>(out - line.constData()));
+  return line;
+}
+
+// Letter with font prefixes (in the order they are read in)
+static char* appendLetter(char* pos, const QByteArray& glyph, int flags) {
+  if (flags & BoxStore::Bold)
+    *pos++ = '@';
+  if (flags & BoxStore::Italic)
+    *pos++ = '$';
+  if (flags & BoxStore::Underline)
+    *pos++ = '\'';
+  memcpy(pos, glyph.constData(), glyph.size());
+  return pos + glyph.size();
+}
+
+void BoxSerializer::appendRow(QByteArray* out, const BoxColumns& columns,
+                              int row, const QVector<QByteArray>& glyphs,
+                              bool wordStr) {
+  const QByteArray& glyph = glyphs.at(columns.glyph.at(row));
+  int flags = columns.flags.at(row);
+  wordStr = wordStr && glyph != "\t";
+
+  int start = out->size();
+  out->resize(start + kWordStrLength + 2 + 3 + glyph.size() +
+              5 * (kMaxIntLength + 1));
+  char* pos = out->data() + start;
+  if (wordStr) {
+    memcpy(pos, kWordStr, kWordStrLength);
+    pos += kWordStrLength;
+  } else {
+    pos = appendLetter(pos, glyph, flags);
+  }
+
+  int values[5] = { columns.left.at(row), columns.bottom.at(row),
+                    columns.right.at(row), columns.top.at(row),
+                    columns.page.at(row) };
+  for (int i = 0; i < 5; ++i) {
+    *pos++ = ' ';
+    pos = appendInt(pos, values[i]);
+  }
+
+  // Text of WordStr line has no font prefixes
+  if (wordStr) {
+    *pos++ = ' ';
+    *pos++ = '#';
+    pos = appendLetter(pos, glyph, 0);
+  }
+  out->resize(static_cast<int>(pos - out->constData()));
+}
+
+char* BoxSerializer::appendInt(char* out, int value) {
+  unsigned int magnitude = static_cast<unsigned int>(value);
+  if (value < 0) {
+    *out++ = '-';
+    magnitude = 0u - magnitude;
+  }
+
+  char buffer[kMaxIntLength];
+  char* end = buffer + kMaxIntLength;
+  char* pos = end;
+  while (magnitude >= 100) {
+    unsigned int pair = (magnitude % 100) * 2;
+    magnitude /= 100;
+    pos -= 2;
+    memcpy(pos, kDigitPairs + pair, 2);
+  }
+  if (magnitude >= 10) {
+    pos -= 2;
+    memcpy(pos, kDigitPairs + magnitude * 2, 2);
+  } else {
+    *--pos = static_cast<char>('0' + magnitude);
+  }
+  memcpy(out, pos, end - pos);
+  return out + (end - pos);
+}
@@ -0,0 +1,56 @@
+/**********************************************************************
+* File:        BoxSerializer.h
+* Description: Fast formatting of box file rows
+* Author:      qt-box-editor contributors
+* Created:     2026-10-16
+*
+* (C) Copyright 2026, qt-box-editor contributors
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**    http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*
+**********************************************************************/
+
+#ifndef SRC_BOXSERIALIZER_H_
+#define SRC_BOXSERIALIZER_H_
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+#include "BoxStore.h"
+
+/**
+ * Formats box rows directly to UTF-8 bytes.
+ * Integers are converted two digits at a time without QString or
+ * QTextStream in between, so a row costs one small allocation.
+ */
+class BoxSerializer {
+  public:
+    /** Box line "letter left bottom right top page" (without newline). */
+    static QByteArray formatRow(const QString& letter, int left, int bottom,
+                                int right, int top, int page);
+    /** Line-level row "WordStr left bottom right top page #text". */
+    static QByteArray formatWordStr(const QString& text, int left, int bottom,
+                                    int right, int top, int page);
+    /**
+     * Append box of columns as line (without newline) to out. Glyph ids
+     * index glyphs (UTF-8), flags become font prefixes of letter. Boxes
+     * of line-level file are WordStr lines, except of tab (end of line).
+     */
+    static void appendRow(QByteArray* out, const BoxColumns& columns, int row,
+                          const QVector<QByteArray>& glyphs, bool wordStr);
+    /** Write decimal value to out, return position after last digit. */
+    static char* appendInt(char* out, int value);
+};
+
+#endif  // SRC_BOXSERIALIZER_H_
@@ -0,0 +1,217 @@
+/**********************************************************************
+* File:        BoxStore.cpp
+* Description: Columnar storage of decoded boxes and interned glyphs
+* Author:      qt-box-editor contributors
+* Created:     2026-10-16
+*
+* (C) Copyright 2026, qt-box-editor contributors
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**    http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*
+**********************************************************************/
+
+#include "BoxParser.h"
+#include "BoxStore.h"
+
+void BoxColumns::reserve(int size) {
+  glyph.reserve(size);
+  left.reserve(size);
+  bottom.reserve(size);
+  right.reserve(size);
+  top.reserve(size);
+  page.reserve(size);
+  flags.reserve(size);
+}
+
+void BoxColumns::clear() {
+  glyph.clear();
+  left.clear();
+  bottom.clear();
+  right.clear();
+  top.clear();
+  page.clear();
+  flags.clear();
+}
+
+void BoxColumns::append(int glyphId, int l, int b, int r, int t, int p,
+                        int f) {
+  glyph.append(glyphId);
+  left.append(l);
+  bottom.append(b);
+  right.append(r);
+  top.append(t);
+  page.append(p);
+  flags.append(static_cast<quint8>(f));
+}
+
+void BoxColumns::append(const BoxColumns& other, int row) {
+  append(other.glyph.at(row), other.left.at(row), other.bottom.at(row),
+         other.right.at(row), other.top.at(row), other.page.at(row),
+         other.flags.at(row));
+}
+
+void BoxColumns::insert(int row, const BoxColumns& other, int otherRow) {
+  glyph.insert(row, other.glyph.at(otherRow));
+  left.insert(row, other.left.at(otherRow));
+  bottom.insert(row, other.bottom.at(otherRow));
+  right.insert(row, other.right.at(otherRow));
+  top.insert(row, other.top.at(otherRow));
+  page.insert(row, other.page.at(otherRow));
+  flags.insert(row, other.flags.at(otherRow));
+}
+
+template <class T>
+static void insertColumn(QVector<T>* column, int row, const QVector<T>& other,
+                         int otherRow, int count) {
+  column->insert(row, count, T());
+  T* target = column->data() + row;
+  const T* source = other.constData() + otherRow;
+  for (int i = 0; i < count; ++i)
+    target[i] = source[i];
+}
+
+void BoxColumns::insert(int row, const BoxColumns& other, int otherRow,
+                        int count) {
+  insertColumn(&glyph, row, other.glyph, otherRow, count);
+  insertColumn(&left, row, other.left, otherRow, count);
+  insertColumn(&bottom, row, other.bottom, otherRow, count);
+  insertColumn(&right, row, other.right, otherRow, count);
+  insertColumn(&top, row, other.top, otherRow, count);
+  insertColumn(&page, row, other.page, otherRow, count);
+  insertColumn(&flags, row, other.flags, otherRow, count);
+}
+
+void BoxColumns::replace(int row, const BoxColumns& other, int otherRow) {
+  glyph[row] = other.glyph.at(otherRow);
+  left[row] = other.left.at(otherRow);
+  bottom[row] = other.bottom.at(otherRow);
+  right[row] = other.right.at(otherRow);
+  top[row] = other.top.at(otherRow);
+  page[row] = other.page.at(otherRow);
+  flags[row] = other.flags.at(otherRow);
+}
+
+void BoxColumns::remove(int row) {
+  glyph.remove(row);
+  left.remove(row);
+  bottom.remove(row);
+  right.remove(row);
+  top.remove(row);
+  page.remove(row);
+  flags.remove(row);
+}
+
+void BoxColumns::remove(int row, int count) {
+  glyph.remove(row, count);
+  left.remove(row, count);
+  bottom.remove(row, count);
+  right.remove(row, count);
+  top.remove(row, count);
+  page.remove(row, count);
+  flags.remove(row, count);
+}
+
+void BoxColumns::flipVertical(int height) {
+  qint32* b = bottom.data();
+  qint32* t = top.data();
+  for (int row = 0; row < bottom.size(); ++row) {
+    b[row] = height - b[row];
+    t[row] = height - t[row];
+  }
+}
+
+bool BoxColumns::operator==(const BoxColumns& other) const {
+  return glyph == other.glyph && left == other.left &&
+         bottom == other.bottom && right == other.right &&
+         top == other.top && page == other.page && flags == other.flags;
+}
+
+int BoxStore::intern(const QString& glyph) {
+  QByteArray utf8 = glyph.toUtf8();
+  return intern(utf8.constData(), utf8.size());
+}
+
+int BoxStore::intern(const char* utf8, int length) {
+  // Lookup without copying the bytes
+  QHash<QByteArray, int>::const_iterator it =
+    m_ids.constFind(QByteArray::fromRawData(utf8, length));
+  if (it != m_ids.constEnd())
+    return it.value();
+
+  QByteArray key(utf8, length);
+  int id = m_glyphs.size();
+  m_glyphs.append(QString::fromUtf8(utf8, length));
+  m_utf8.append(key);
+  m_ids.insert(key, id);
+  return id;
+}
+
+void BoxStore::clear() {
+  m_glyphs.clear();
+  m_utf8.clear();
+  m_ids.clear();
+}
+
+bool BoxStore::appendLine(BoxColumns* columns, const char* begin,
+                          const char* end) {
+  const char* field[BoxParser::kMaxFields];
+  int fieldLength[BoxParser::kMaxFields];
+  int count = BoxParser::fields(begin, end, field, fieldLength);
+  // Line of journal or of file changed on disk was not validated by
+  // BoxParser, fields over stored ones are never read
+  int stored = qMin(count, static_cast<int>(BoxParser::kMaxFields));
+
+  const char* letter = field[0];
+  int letterLength = fieldLength[0];
+  const char* text = BoxParser::wordStrText(begin, end);
+  bool valid = count == 6 || count == 7 || (count > 7 && text);
+  int first = 0;
+  if (text) {
+    letter = text;
+    letterLength = static_cast<int>(end - text);
+  } else if (count == 7 && *begin == ' ') {
+    first = 1;  // tess2image generate also box for spaces
+    letter = field[1];
+    letterLength = fieldLength[1];
+  }
+
+  // Font prefixes are there only if the letter has more characters.
+  // Text of WordStr line is kept verbatim, it can start with any of them.
+  int flags = 0;
+  if (!text && letterLength > 1 && *letter == '@') {
+    flags |= Bold;
+    ++letter;
+    --letterLength;
+  }
+  if (!text && letterLength > 1 && *letter == '$') {
+    flags |= Italic;
+    ++letter;
+    --letterLength;
+  }
+  if (!text && letterLength > 1 && *letter == '\'') {
+    flags |= Underline;
+    ++letter;
+    --letterLength;
+  }
+
+  int value[5];
+  for (int i = 0; i < 5; ++i) {
+    int f = first + 1 + i;
+    if (f >= stored ||
+        !BoxParser::parseInt(field[f], field[f] + fieldLength[f], &value[i]))
+      value[i] = 0;
+  }
+  columns->append(intern(letter, letterLength), value[0], value[1], value[2],
+                  value[3], value[4], flags);
+  return valid;
+}
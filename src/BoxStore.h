@@ -0,0 +1,116 @@
+/**********************************************************************
+* File:        BoxStore.h
+* Description: Columnar storage of decoded boxes and interned glyphs
+* Author:      qt-box-editor contributors
+* Created:     2026-10-16
+*
+* (C) Copyright 2026, qt-box-editor contributors
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**    http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*
+**********************************************************************/
+
+#ifndef SRC_BOXSTORE_H_
+#define SRC_BOXSTORE_H_
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+/**
+ * Boxes of one page, column by column (structure of arrays).
+ *
+ * Coordinates are the ones of box file (origin in bottom left corner) in
+ * document. Shown page (BoxTableModel) keeps them in image coordinates
+ * (origin in top left corner), see flipVertical().
+ * Letter is an id of glyph interned in BoxStore and its font prefixes
+ * (@ $ ') are kept as flags, so a box takes 6 * 4 + 1 = 25 bytes.
+ */
+struct BoxColumns {
+    int size() const {
+        return glyph.size();
+    }
+    void reserve(int size);
+    void clear();
+    void append(int glyphId, int l, int b, int r, int t, int p, int f);
+    /** Append row of other columns. */
+    void append(const BoxColumns& other, int row);
+    void insert(int row, const BoxColumns& other, int otherRow);
+    /** Insert count rows of other (from otherRow) before row at once. */
+    void insert(int row, const BoxColumns& other, int otherRow, int count);
+    void replace(int row, const BoxColumns& other, int otherRow);
+    void remove(int row);
+    void remove(int row, int count);
+    bool operator==(const BoxColumns& other) const;
+    /**
+     * Convert bottom/top between box file and image coordinates of image
+     * with height. Conversion is its own inverse.
+     */
+    void flipVertical(int height);
+
+    QVector<qint32> glyph;  /**< id in BoxStore glyph table */
+    QVector<qint32> left;
+    QVector<qint32> bottom;
+    QVector<qint32> right;
+    QVector<qint32> top;
+    QVector<qint32> page;
+    QVector<quint8> flags;  /**< BoxStore::Flag bits */
+};
+
+/**
+ * Table of interned glyphs (letters, or texts of WordStr lines) and
+ * decoding of box lines to BoxColumns.
+ *
+ * Ids are never reused or removed while the store lives, so columns of
+ * any page (or of a running save) stay valid. The UTF-8 table is an
+ * implicitly shared vector that other threads can keep a copy of.
+ */
+class BoxStore {
+  public:
+    enum Flag {
+        Bold = 0x1,
+        Italic = 0x2,
+        Underline = 0x4
+    };
+
+    /** Id of glyph, new glyph is added to table. */
+    int intern(const QString& glyph);
+    int intern(const char* utf8, int length);
+    QString glyph(int id) const {
+        return m_glyphs.at(id);
+    }
+    int glyphCount() const {
+        return m_glyphs.size();
+    }
+    /** UTF-8 of all glyphs indexed by id. */
+    QVector<QByteArray> utf8Glyphs() const {
+        return m_utf8;
+    }
+    void clear();
+
+    /**
+     * Decode box line and append it to columns. Numbers that are not
+     * valid (or missing) are stored as 0, as table always showed them.
+     * False if line has wrong number of fields (box is appended anyway,
+     * so rows of page stay in place).
+     */
+    bool appendLine(BoxColumns* columns, const char* begin, const char* end);
+
+  private:
+    QVector<QString> m_glyphs;
+    QVector<QByteArray> m_utf8;
+    QHash<QByteArray, int> m_ids;
+};
+
+#endif  // SRC_BOXSTORE_H_
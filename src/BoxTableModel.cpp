@@ -0,0 +1,265 @@
+/**********************************************************************
+* File:        BoxTableModel.cpp
+* Description: Table model of boxes of one page
+* Author:      qt-box-editor contributors
+* Created:     2026-10-16
+*
+* (C) Copyright 2026, qt-box-editor contributors
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**    http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*
+**********************************************************************/
+
+#include <QFont>
+
+#include "BoxTableModel.h"
+
+BoxTableModel::BoxTableModel(BoxStore* store, QObject* parent)
+  : QAbstractTableModel(parent),
+    m_store(store) {
+}
+
+void BoxTableModel::setBoxes(const BoxColumns& boxes) {
+  clear();
+  if (boxes.size() == 0)
+    return;
+
+  beginInsertRows(QModelIndex(), 0, boxes.size() - 1);
+  m_boxes = boxes;
+  endInsertRows();
+}
+
+void BoxTableModel::clear() {
+  beginResetModel();
+  m_boxes.clear();
+  endResetModel();
+}
+
+int BoxTableModel::rowCount(const QModelIndex& parent) const {
+  return parent.isValid() ? 0 : m_boxes.size();
+}
+
+int BoxTableModel::columnCount(const QModelIndex& parent) const {
+  return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant BoxTableModel::data(const QModelIndex& index, int role) const {
+  if (!index.isValid() || index.row() >= m_boxes.size())
+    return QVariant();
+  int row = index.row();
+  int flags = m_boxes.flags.at(row);
+
+  if (role == Qt::FontRole) {
+    // Only set attributes are applied over font of table
+    if (index.column() != Letter || flags == 0)
+      return QVariant();
+    QFont letterFont;
+    if (flags & BoxStore::Bold)
+      letterFont.setBold(true);
+    if (flags & BoxStore::Italic)
+      letterFont.setItalic(true);
+    if (flags & BoxStore::Underline)
+      letterFont.setUnderline(true);
+    return letterFont;
+  }
+  if (role != Qt::DisplayRole && role != Qt::EditRole)
+    return QVariant();
+
+  switch (index.column()) {
+    case Letter:
+      return m_store->glyph(m_boxes.glyph.at(row));
+    case Left:
+      return m_boxes.left.at(row);
+    case Bottom:
+      return m_boxes.bottom.at(row);
+    case Right:
+      return m_boxes.right.at(row);
+    case Top:
+      return m_boxes.top.at(row);
+    case Page:
+      return m_boxes.page.at(row);
+    case Italic:
+      return (flags & BoxStore::Italic) != 0;
+    case Bold:
+      return (flags & BoxStore::Bold) != 0;
+    case Underline:
+      return (flags & BoxStore::Underline) != 0;
+  }
+  return QVariant();
+}
+
+bool BoxTableModel::setData(const QModelIndex& index, const QVariant& value,
+                            int role) {
+  if (!index.isValid() || index.row() >= m_boxes.size())
+    return false;
+  int row = index.row();
+
+  if (role == Qt::FontRole) {
+    if (index.column() != Letter)
+      return false;
+    QFont letterFont = value.value<QFont>();
+    setFlag(row, BoxStore::Italic, letterFont.italic());
+    setFlag(row, BoxStore::Bold, letterFont.bold());
+    setFlag(row, BoxStore::Underline, letterFont.underline());
+    emit dataChanged(index, this->index(row, Underline));
+    return true;
+  }
+  if (role != Qt::EditRole && role != Qt::DisplayRole)
+    return false;
+  if (!setCell(row, index.column(), value))
+    return false;
+
+  // Flag changes font of letter too
+  if (index.column() >= Italic && index.column() <= Underline)
+    emit dataChanged(this->index(row, Letter), index);
+  else
+    emit dataChanged(index, index);
+  return true;
+}
+
+bool BoxTableModel::setRow(int row, const QVariant* values) {
+  if (row < 0 || row >= m_boxes.size())
+    return false;
+  for (int column = 0; column < ColumnCount; ++column)
+    setCell(row, column, values[column]);
+  emit dataChanged(index(row, Letter), index(row, Underline));
+  return true;
+}
+
+bool BoxTableModel::setRow(int row, const BoxColumns& boxes, int boxRow) {
+  if (row < 0 || row >= m_boxes.size() || boxRow < 0 ||
+      boxRow >= boxes.size())
+    return false;
+  m_boxes.glyph[row] = boxes.glyph.at(boxRow);
+  m_boxes.left[row] = boxes.left.at(boxRow);
+  m_boxes.bottom[row] = boxes.bottom.at(boxRow);
+  m_boxes.right[row] = boxes.right.at(boxRow);
+  m_boxes.top[row] = boxes.top.at(boxRow);
+  m_boxes.page[row] = boxes.page.at(boxRow);
+  m_boxes.flags[row] = boxes.flags.at(boxRow);
+  emit dataChanged(index(row, Letter), index(row, Underline));
+  return true;
+}
+
+bool BoxTableModel::setCell(int row, int column, const QVariant& value) {
+  switch (column) {
+    case Letter:
+      m_boxes.glyph[row] = m_store->intern(value.toString());
+      break;
+    case Left:
+      m_boxes.left[row] = value.toInt();
+      break;
+    case Bottom:
+      m_boxes.bottom[row] = value.toInt();
+      break;
+    case Right:
+      m_boxes.right[row] = value.toInt();
+      break;
+    case Top:
+      m_boxes.top[row] = value.toInt();
+      break;
+    case Page:
+      m_boxes.page[row] = value.toInt();
+      break;
+    case Italic:
+      setFlag(row, BoxStore::Italic, value.toBool());
+      break;
+    case Bold:
+      setFlag(row, BoxStore::Bold, value.toBool());
+      break;
+    case Underline:
+      setFlag(row, BoxStore::Underline, value.toBool());
+      break;
+    default:
+      return false;
+  }
+  return true;
+}
+
+void BoxTableModel::setFlag(int row, int flag, bool on) {
+  if (on)
+    m_boxes.flags[row] |= flag;
+  else
+    m_boxes.flags[row] &= ~flag;
+}
+
+QVariant BoxTableModel::headerData(int section, Qt::Orientation orientation,
+                                   int role) const {
+  if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+    return QAbstractTableModel::headerData(section, orientation, role);
+
+  switch (section) {
+    case Letter:
+      return tr("Letter");
+    case Left:
+      return tr("Left");
+    case Bottom:
+      return tr("Bottom");
+    case Right:
+      return tr("Right");
+    case Top:
+      return tr("Top");
+    case Page:
+      return tr("Page");
+    case Italic:
+      return tr("Italic");
+    case Bold:
+      return tr("Bold");
+    case Underline:
+      return tr("Underline");
+  }
+  return QVariant();
+}
+
+Qt::ItemFlags BoxTableModel::flags(const QModelIndex& index) const {
+  if (!index.isValid())
+    return Qt::NoItemFlags;
+  return QAbstractTableModel::flags(index) | Qt::ItemIsEditable;
+}
+
+bool BoxTableModel::insertRows(int row, int count, const QModelIndex& parent) {
+  if (parent.isValid() || row < 0 || row > m_boxes.size() || count < 1)
+    return false;
+
+  // New rows are empty boxes, caller fills them by setData()
+  BoxColumns empty;
+  empty.append(m_store->intern(QString()), 0, 0, 0, 0, 0, 0);
+  beginInsertRows(QModelIndex(), row, row + count - 1);
+  for (int i = 0; i < count; ++i)
+    m_boxes.insert(row, empty, 0);
+  endInsertRows();
+  return true;
+}
+
+bool BoxTableModel::removeRows(int row, int count, const QModelIndex& parent) {
+  if (parent.isValid() || row < 0 || count < 1 ||
+      row + count > m_boxes.size())
+    return false;
+
+  beginRemoveRows(QModelIndex(), row, row + count - 1);
+  m_boxes.remove(row, count);
+  endRemoveRows();
+  return true;
+}
+
+bool BoxTableModel::insertBoxes(int row, const BoxColumns& boxes, int first,
+                                int count) {
+  if (row < 0 || row > m_boxes.size() || count < 1 ||
+      first < 0 || first + count > boxes.size())
+    return false;
+
+  beginInsertRows(QModelIndex(), row, row + count - 1);
+  m_boxes.insert(row, boxes, first, count);
+  endInsertRows();
+  return true;
+}
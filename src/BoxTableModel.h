@@ -0,0 +1,99 @@
+/**********************************************************************
+* File:        BoxTableModel.h
+* Description: Table model of boxes of one page
+* Author:      qt-box-editor contributors
+* Created:     2026-10-16
+*
+* (C) Copyright 2026, qt-box-editor contributors
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**    http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*
+**********************************************************************/
+
+#ifndef SRC_BOXTABLEMODEL_H_
+#define SRC_BOXTABLEMODEL_H_
+
+#include <QAbstractTableModel>
+#include <QVariant>
+
+#include "BoxStore.h"
+
+/**
+ * Boxes of one page for the table view.
+ *
+ * Model keeps the page as BoxColumns and data() is computed on request, so
+ * no item is allocated per cell. Coordinates are image coordinates (origin
+ * in the top left corner) as shown, so cells and box layer read them with
+ * no conversion. Font of letter column follows italic/bold/underline flags.
+ */
+class BoxTableModel : public QAbstractTableModel {
+    Q_OBJECT
+
+  public:
+    enum Column {
+        Letter,
+        Left,
+        Bottom,
+        Right,
+        Top,
+        Page,
+        Italic,
+        Bold,
+        Underline,
+        ColumnCount
+    };
+
+    explicit BoxTableModel(BoxStore* store, QObject* parent = 0);
+
+    /**
+     * Replace all rows with boxes of page. Rows are announced by a single
+     * rowsInserted() signal.
+     */
+    void setBoxes(const BoxColumns& boxes);
+    /** Boxes of all rows, in image coordinates. */
+    const BoxColumns& boxes() const {
+        return m_boxes;
+    }
+    void clear();
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const;
+    int columnCount(const QModelIndex& parent = QModelIndex()) const;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const;
+    bool setData(const QModelIndex& index, const QVariant& value,
+                 int role = Qt::EditRole);
+    /**
+     * Set all ColumnCount columns of row from values (as returned by
+     * data()) with a single dataChanged() signal.
+     */
+    bool setRow(int row, const QVariant* values);
+    /** Set row to box boxRow of boxes, with a single dataChanged(). */
+    bool setRow(int row, const BoxColumns& boxes, int boxRow);
+    QVariant headerData(int section, Qt::Orientation orientation,
+                        int role = Qt::DisplayRole) const;
+    Qt::ItemFlags flags(const QModelIndex& index) const;
+    bool insertRows(int row, int count,
+                    const QModelIndex& parent = QModelIndex());
+    bool removeRows(int row, int count,
+                    const QModelIndex& parent = QModelIndex());
+    /** Insert count rows of boxes (from first) before row, with data. */
+    bool insertBoxes(int row, const BoxColumns& boxes, int first, int count);
+
+  private:
+    bool setCell(int row, int column, const QVariant& value);
+    void setFlag(int row, int flag, bool on);
+
+    BoxStore* m_store;
+    BoxColumns m_boxes;
+};
+
+#endif  // SRC_BOXTABLEMODEL_H_
@@ -0,0 +1,100 @@
+/**********************************************************************
+* File:        BoxUndoLog.cpp
+* Description: Undo history of packed records with bounded memory
+* Author:      qt-box-editor contributors
+* Created:     2026-10-16
+*
+* (C) Copyright 2026, qt-box-editor contributors
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**    http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*
+**********************************************************************/
+
+#include "BoxUndoLog.h"
+
+BoxUndoLog::BoxUndoLog()
+  : m_bytes(0),
+    m_limit(kDefaultLimit) {
+}
+
+void BoxUndoLog::setMemoryLimit(qint64 bytes) {
+  m_limit = bytes;
+  if (m_bytes > m_limit)
+    spill();
+}
+
+void BoxUndoLog::push(const QByteArray& record) {
+  m_records.append(record);
+  m_bytes += record.size();
+  if (m_bytes > m_limit)
+    spill();
+}
+
+QByteArray BoxUndoLog::pop() {
+  if (!m_records.isEmpty()) {
+    QByteArray record = m_records.last();
+    m_records.pop_back();
+    m_bytes -= record.size();
+    return record;
+  }
+  if (m_offsets.isEmpty())
+    return QByteArray();
+
+  // Newest spilled record is at the end of file
+  qint64 offset = m_offsets.last();
+  m_offsets.pop_back();
+  QByteArray record;
+  if (m_file.seek(offset))
+    record = m_file.read(m_file.size() - offset);
+  m_file.resize(offset);
+  return record;
+}
+
+void BoxUndoLog::clear() {
+  m_records.clear();
+  m_bytes = 0;
+  m_offsets.clear();
+  if (m_file.isOpen())
+    m_file.resize(0);
+}
+
+/*
+ * The oldest records are moved out until half of limit is used, so spill
+ * does not happen on every push.
+ */
+void BoxUndoLog::spill() {
+  if (!m_file.isOpen() && !m_file.open()) {
+    // No spill file - the oldest history is dropped to keep memory flat
+    int count = 0;
+    while (m_bytes > m_limit / 2 && count < m_records.size())
+      m_bytes -= m_records.at(count++).size();
+    m_records.remove(0, count);
+    return;
+  }
+
+  int count = 0;
+  qint64 end = m_file.size();
+  m_file.seek(end);
+  while (m_bytes > m_limit / 2 && count < m_records.size()) {
+    const QByteArray& record = m_records.at(count);
+    if (m_file.write(record) != record.size()) {
+      m_file.resize(end);  // drop torn record
+      break;
+    }
+    m_offsets.append(end);
+    end += record.size();
+    m_bytes -= record.size();
+    ++count;
+  }
+  m_records.remove(0, count);
+}
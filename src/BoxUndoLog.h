@@ -0,0 +1,64 @@
+/**********************************************************************
+* File:        BoxUndoLog.h
+* Description: Undo history of packed records with bounded memory
+* Author:      qt-box-editor contributors
+* Created:     2026-10-16
+*
+* (C) Copyright 2026, qt-box-editor contributors
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**    http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*
+**********************************************************************/
+
+#ifndef SRC_BOXUNDOLOG_H_
+#define SRC_BOXUNDOLOG_H_
+
+#include <QByteArray>
+#include <QTemporaryFile>
+#include <QVector>
+
+/**
+ * Stack of packed undo (or redo) records.
+ *
+ * Newest records are kept in memory. When they take more than the memory
+ * limit, the oldest ones are moved to a temporary file and read back one
+ * by one when history is unwound that far. Memory therefore stays flat in
+ * long sessions while no history is lost. Spill file is private to the
+ * process and removed with the log.
+ */
+class BoxUndoLog {
+  public:
+    static const int kDefaultLimit = 16 * 1024 * 1024;
+
+    BoxUndoLog();
+
+    void setMemoryLimit(qint64 bytes);
+    void push(const QByteArray& record);
+    /** Remove and return newest record (empty if there is none). */
+    QByteArray pop();
+    bool isEmpty() const {
+        return m_records.isEmpty() && m_offsets.isEmpty();
+    }
+    void clear();
+
+  private:
+    void spill();
+
+    QVector<QByteArray> m_records;  /**< in memory, oldest first */
+    qint64 m_bytes;                 /**< size of m_records */
+    qint64 m_limit;
+    QTemporaryFile m_file;          /**< older records, oldest first */
+    QVector<qint64> m_offsets;      /**< start of every record in m_file */
+};
+
+#endif  // SRC_BOXUNDOLOG_H_
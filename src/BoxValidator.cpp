@@ -0,0 +1,273 @@
+/**********************************************************************
+* File:        BoxValidator.cpp
+* Description: Single pass check of box data collecting all problems
+* Author:      qt-box-editor contributors
+* Created:     2026-10-16
+*
+* (C) Copyright 2026, qt-box-editor contributors
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**    http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*
+**********************************************************************/
+
+#include <string.h>
+
+#include <QCoreApplication>
+#include <QIODevice>
+
+#include "BoxDocument.h"
+#include "BoxValidator.h"
+
+// Read coordinates and page of line to value (left, bottom, right, top,
+// page), isInt tells which of them are numbers. Returns number of fields
+// if it is wrong for a box line, 0 otherwise.
+static int boxFields(const char* begin, const char* end, int* value,
+                     bool* isInt) {
+  const char* field[BoxParser::kMaxFields];
+  int fieldLength[BoxParser::kMaxFields];
+  int count = BoxParser::fields(begin, end, field, fieldLength);
+
+  if (count < 6 || (count > 7 && !BoxParser::wordStrText(begin, end)))
+    return count;
+  int first = (count == 7 && *begin == ' ') ? 1 : 0;  // box for space
+
+  for (int i = 0; i < 5; ++i) {
+    const char* start = field[first + 1 + i];
+    isInt[i] = BoxParser::parseInt(start, start + fieldLength[first + 1 + i],
+                                   &value[i]);
+    if (!isInt[i])
+      value[i] = -1;  // the same page number BoxParser uses
+  }
+  return 0;
+}
+
+// Number of line breaks in [begin, end)
+static int countLines(const char* begin, const char* end) {
+  int lines = 0;
+  while (begin < end) {
+    const char* newline =
+      static_cast<const char*>(memchr(begin, '\n', end - begin));
+    if (!newline)
+      break;
+    ++lines;
+    begin = newline + 1;
+  }
+  return lines;
+}
+
+QString BoxIssue::message() const {
+  switch (type) {
+    case FieldCount:
+      return QCoreApplication::translate(
+               "BoxValidator", "Wrong number of fields (%1)").arg(value);
+    case NotInteger:
+      return QCoreApplication::translate(
+               "BoxValidator", "Coordinate or page is not an integer");
+    case Inverted:
+      return QCoreApplication::translate(
+               "BoxValidator", "Inverted box (left > right or bottom > top)");
+    case OutsideImage:
+      return QCoreApplication::translate(
+               "BoxValidator", "Box is outside of image");
+    case PageOrder:
+      return QCoreApplication::translate(
+               "BoxValidator", "Page %1 follows higher page number")
+             .arg(value);
+  }
+  return QString();
+}
+
+BoxValidator::BoxValidator()
+  : m_width(0),
+    m_height(0),
+    m_imagePage(-1),
+    m_line(0),
+    m_pagePrev(0),
+    m_page(0),
+    m_row(0),
+    m_started(false) {
+}
+
+void BoxValidator::setImageSize(int width, int height, int page) {
+  m_width = width;
+  m_height = height;
+  m_imagePage = page;
+}
+
+void BoxValidator::reset() {
+  m_issues.clear();
+  m_line = 0;
+  m_pagePrev = 0;
+  m_page = 0;
+  m_row = 0;
+  m_started = false;
+  m_carry.clear();
+}
+
+void BoxValidator::validate(const char* data, qint64 size) {
+  reset();
+  const char* pos = data;
+  const char* end = data + size;
+  while (pos < end) {
+    const char* newline =
+      static_cast<const char*>(memchr(pos, '\n', end - pos));
+    const char* stop = newline ? newline : end;
+    checkLine(pos, stop);
+    pos = stop + 1;
+  }
+}
+
+bool BoxValidator::validate(QIODevice* device) {
+  reset();
+  QByteArray chunk;
+  chunk.resize(BoxParser::kChunkSize);
+
+  while (true) {
+    qint64 read = device->read(chunk.data(), BoxParser::kChunkSize);
+    if (read < 0)
+      return false;
+    if (read == 0)
+      break;
+    feed(chunk.constData(), static_cast<int>(read));
+  }
+  if (!m_carry.isEmpty()) {
+    checkLine(m_carry.constData(), m_carry.constData() + m_carry.size());
+    m_carry.clear();
+  }
+  return true;
+}
+
+// Lines are split the same way as in BoxParser::feed()
+void BoxValidator::feed(const char* data, int size) {
+  const char* pos = data;
+  const char* end = data + size;
+
+  while (pos < end) {
+    const char* newline =
+      static_cast<const char*>(memchr(pos, '\n', end - pos));
+    if (!newline) {
+      // keep incomplete line for next chunk
+      m_carry.append(pos, static_cast<int>(end - pos));
+      break;
+    }
+    if (m_carry.isEmpty()) {
+      checkLine(pos, newline);
+    } else {
+      m_carry.append(pos, static_cast<int>(newline - pos));
+      checkLine(m_carry.constData(), m_carry.constData() + m_carry.size());
+      m_carry.resize(0);
+    }
+    pos = newline + 1;
+  }
+}
+
+void BoxValidator::checkLine(const char* begin, const char* end) {
+  ++m_line;
+  if (!m_started) {
+    m_started = true;
+    // QTextStream used to skip UTF-8 BOM for us
+    if (end - begin >= 3 && memcmp(begin, "\xEF\xBB\xBF", 3) == 0)
+      begin += 3;
+  }
+  if (end > begin && *(end - 1) == '\r')
+    --end;
+  if (begin == end)
+    return;
+
+  int value[5];
+  bool isInt[5];
+  int count = boxFields(begin, end, value, isInt);
+  if (count) {
+    addIssue(BoxIssue::FieldCount, -1, -1, count);
+    return;
+  }
+  // Page changes the same way as in BoxParser
+  if (value[4] != m_pagePrev) {
+    ++m_page;
+    m_row = 0;
+  }
+  checkBox(value, isInt, m_page, m_row);
+  ++m_row;
+}
+
+void BoxValidator::validate(BoxDocument* document) {
+  reset();
+
+  // Rows of clean pages follow file order, so line breaks are counted
+  // just once from the previous row
+  qint64 counted = 0;
+  int lines = 0;
+  for (int page = 0; page < document->pageCount(); ++page) {
+    document->loadPage(page);
+    int rows = document->rowCount(page);
+    for (int row = 0; row < rows; ++row) {
+      QByteArray line = document->rowBytes(page, row);
+      qint64 offset = document->rowOffset(page, row);
+      if (offset < 0) {
+        m_line = 0;
+      } else {
+        if (offset < counted) {
+          counted = 0;
+          lines = 0;
+        }
+        lines += countLines(document->data() + counted,
+                            document->data() + offset);
+        counted = offset;
+        m_line = lines + 1;
+      }
+      int value[5];
+      bool isInt[5];
+      int count = boxFields(line.constData(), line.constData() + line.size(),
+                            value, isInt);
+      if (count)
+        addIssue(BoxIssue::FieldCount, page, row, count);
+      else
+        checkBox(value, isInt, page, row);
+    }
+  }
+}
+
+void BoxValidator::checkBox(const int* value, const bool* isInt, int page,
+                            int row) {
+  if (!(isInt[0] && isInt[1] && isInt[2] && isInt[3] && isInt[4]))
+    addIssue(BoxIssue::NotInteger, page, row);
+  if (isInt[4]) {
+    if (value[4] < m_pagePrev)
+      addIssue(BoxIssue::PageOrder, page, row, value[4]);
+  }
+  m_pagePrev = value[4];
+  if (!(isInt[0] && isInt[1] && isInt[2] && isInt[3]))
+    return;
+
+  int left = value[0];
+  int bottom = value[1];
+  int right = value[2];
+  int top = value[3];
+  if (left > right || bottom > top)
+    addIssue(BoxIssue::Inverted, page, row);
+  if (m_width > 0 && (m_imagePage < 0 || m_imagePage == page) &&
+      (qMin(left, right) < 0 || qMin(bottom, top) < 0 ||
+       qMax(left, right) > m_width || qMax(bottom, top) > m_height))
+    addIssue(BoxIssue::OutsideImage, page, row);
+}
+
+void BoxValidator::addIssue(BoxIssue::Type type, int page, int row,
+                            int value) {
+  BoxIssue issue;
+  issue.type = type;
+  issue.line = m_line;
+  issue.page = page;
+  issue.row = row;
+  issue.value = value;
+  m_issues.append(issue);
+}
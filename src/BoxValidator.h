@@ -0,0 +1,108 @@
+/**********************************************************************
+* File:        BoxValidator.h
+* Description: Single pass check of box data collecting all problems
+* Author:      qt-box-editor contributors
+* Created:     2026-10-16
+*
+* (C) Copyright 2026, qt-box-editor contributors
+**
+** Licensed under the Apache License, Version 2.0 (the "License");
+** you may not use this file except in compliance with the License.
+** You may obtain a copy of the License at
+**
+**    http://www.apache.org/licenses/LICENSE-2.0
+**
+** Unless required by applicable law or agreed to in writing, software
+** distributed under the License is distributed on an "AS IS" BASIS,
+** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+** See the License for the specific language governing permissions and
+** limitations under the License.
+*
+**********************************************************************/
+
+#ifndef SRC_BOXVALIDATOR_H_
+#define SRC_BOXVALIDATOR_H_
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+class BoxDocument;
+class QIODevice;
+
+/** One problem found in box data. */
+struct BoxIssue {
+    enum Type {
+        FieldCount,    /**< wrong number of fields, line is not loadable */
+        NotInteger,    /**< coordinate or page is not a number */
+        Inverted,      /**< left > right or bottom > top */
+        OutsideImage,  /**< box does not fit to image */
+        PageOrder      /**< page number lower than on previous line */
+    };
+
+    BoxIssue() : type(FieldCount), line(0), page(-1), row(-1), value(0) {}
+
+    Type type;
+    int line;   /**< 1-based line of box file, 0 if unknown (edited) */
+    int page;   /**< page (index of document) of box, -1 if unknown */
+    int row;    /**< row of box on page, -1 if unknown */
+    int value;  /**< field count or page number (by type) */
+
+    /** Human readable (translated) description of issue. */
+    QString message() const;
+};
+
+/**
+ * Checks box data in one pass and collects every problem instead of
+ * stopping at the first one.
+ *
+ * Lines are split to pages with the same rules BoxParser uses, so page
+ * and row of an issue point to the box as it is shown in table. Malformed
+ * lines get no row (they are not loaded at all).
+ */
+class BoxValidator {
+  public:
+    BoxValidator();
+
+    /**
+     * Check boxes against image size. Only boxes of page are checked
+     * (all pages if page is -1), size of other pages is not known.
+     */
+    void setImageSize(int width, int height, int page = -1);
+    /** Check raw box file data. */
+    void validate(const char* data, qint64 size);
+    /**
+     * Check data of device, read in BoxParser::kChunkSize pieces like
+     * BoxParser::parse(device) does. False on read error.
+     */
+    bool validate(QIODevice* device);
+    /**
+     * Check current content of document (including unsaved edits). Rows
+     * of edited pages have no line in file, their issues get line 0.
+     */
+    void validate(BoxDocument* document);
+
+    const QVector<BoxIssue>& issues() const {
+        return m_issues;
+    }
+
+  private:
+    void reset();
+    void feed(const char* data, int size);
+    void checkLine(const char* begin, const char* end);
+    void checkBox(const int* value, const bool* isInt, int page, int row);
+    void addIssue(BoxIssue::Type type, int page, int row, int value = 0);
+
+    QVector<BoxIssue> m_issues;
+    int m_width;
+    int m_height;
+    int m_imagePage;
+    int m_line;
+    int m_pagePrev;  /**< page number of previous loadable line */
+    int m_page;      /**< page and row of next loadable line */
+    int m_row;
+    bool m_started;
+    QByteArray m_carry;  /**< incomplete line from previous chunk */
+};
+
+#endif  // SRC_BOXVALIDATOR_H_
@@ -28,6 +28,9 @@
 #include <leptonica/allheaders.h>
 
 #include "ChildWidget.h"
+#include "BoxGzip.h"
+#include "BoxSaveJob.h"
+#include "BoxSerializer.h"
 #include "Settings.h"
 #include "DelegateEditors.h"
 #include "TessTools.h"
@@ -36,9 +39,6 @@
 #include "dialogs/FindDialog.h"
 #include "dialogs/DrawRectangle.h"
 
-// This allows storing QGraphicsRectItem's in table model data
-Q_DECLARE_METATYPE(QGraphicsRectItem*)
-
 // Print debug message
 int DMESS = 10;
 
@@ -210,10 +210,13 @@ ChildWidget::ChildWidget(QWidget* parent)
   #endif
   table->installEventFilter(this);  // installs event filter
   initTable();
+  initDelegates();
 
   // Make graphics Scene and View
   imageScene = new QGraphicsScene;
   imageScene->installEventFilter(this);
+  boxLayer = new BoxLayer;
+  imageScene->addItem(boxLayer);
   imageView = new QGraphicsView(imageScene);
   imageView->setTransformationAnchor(QGraphicsView::AnchorUnderMouse);
   imageView->setRenderHints(QPainter::Antialiasing |
@@ -360,41 +363,92 @@ ChildWidget::ChildWidget(QWidget* parent)
   rubberBand = new QRubberBand(QRubberBand::Rectangle, imageView);
 
   m_undostack.SetRedoStack(&m_redostack);
+  m_undostack.setStore(&document.store());
+  m_redostack.setStore(&document.store());
   bIsSpinBoxChanged = false;
   bIsLineEditChanged = false;
   fileWatcher = 0;
+  saveJob = 0;
+  editGeneration = 0;
+  saveGeneration = 0;
+  savePool.setMaxThreadCount(1);
+  saveJournalPosition = 0;
+  journalBlocked = false;
+  editDepth = 0;
+  editPending = false;
+  selectionCacheValid = false;
+  lastSelectedRowCache = -1;
 }
 
 void ChildWidget::initTable() {
   if (DMESS > 10) qDebug() << Q_FUNC_INFO;
-  model = new QStandardItemModel(0, 10, this);
-  model->setHeaderData(0, Qt::Horizontal, tr("Letter"));
-  model->setHeaderData(1, Qt::Horizontal, tr("Left"));
-  model->setHeaderData(2, Qt::Horizontal, tr("Bottom"));
-  model->setHeaderData(3, Qt::Horizontal, tr("Right"));
-  model->setHeaderData(4, Qt::Horizontal, tr("Top"));
-  model->setHeaderData(5, Qt::Horizontal, tr("Page"));
-  model->setHeaderData(6, Qt::Horizontal, tr("Italic"));
-  model->setHeaderData(7, Qt::Horizontal, tr("Bold"));
-  model->setHeaderData(8, Qt::Horizontal, tr("Underline"));
-  model->setHeaderData(9, Qt::Horizontal, tr("<Hidden> BB"));
-  table->setModel(model);
+  model = new BoxTableModel(&document.store(), this);
   selectionModel = new QItemSelectionModel(model);
   connect(
     selectionModel,
     SIGNAL(selectionChanged(const QItemSelection&, const QItemSelection&)),
     this, SLOT(selectionChanged(const QItemSelection&, const QItemSelection&)));
+  attachModel();
+
+  // Every edit of model is journaled (except of filling the table)
+  connect(model, SIGNAL(rowsInserted(const QModelIndex&, int, int)), this,
+          SLOT(journalRowsInserted(const QModelIndex&, int, int)));
+  connect(model, SIGNAL(rowsRemoved(const QModelIndex&, int, int)), this,
+          SLOT(journalRowsRemoved(const QModelIndex&, int, int)));
+  connect(model, SIGNAL(dataChanged(const QModelIndex&, const QModelIndex&)),
+          this,
+          SLOT(journalDataChanged(const QModelIndex&, const QModelIndex&)));
+
+  // Boxes on image follow rows of model
+  connect(model, SIGNAL(rowsInserted(const QModelIndex&, int, int)), this,
+          SLOT(layerRowsInserted(const QModelIndex&, int, int)));
+  connect(model, SIGNAL(rowsRemoved(const QModelIndex&, int, int)), this,
+          SLOT(layerRowsRemoved(const QModelIndex&, int, int)));
+  connect(model, SIGNAL(dataChanged(const QModelIndex&, const QModelIndex&)),
+          this,
+          SLOT(layerDataChanged(const QModelIndex&, const QModelIndex&)));
+  connect(model, SIGNAL(modelReset()), this, SLOT(layerReset()));
+
+  // Edits are reported once per user action (see beginEdit())
+  connect(model, SIGNAL(rowsInserted(const QModelIndex&, int, int)), this,
+          SLOT(modelChanged()));
+  connect(model, SIGNAL(rowsRemoved(const QModelIndex&, int, int)), this,
+          SLOT(modelChanged()));
+  connect(model, SIGNAL(dataChanged(const QModelIndex&, const QModelIndex&)),
+          this, SLOT(modelChanged()));
+
+  // Selection model moves selected rows on row changes
+  connect(model, SIGNAL(rowsInserted(const QModelIndex&, int, int)), this,
+          SLOT(invalidateSelectionCache()));
+  connect(model, SIGNAL(rowsRemoved(const QModelIndex&, int, int)), this,
+          SLOT(invalidateSelectionCache()));
+  connect(model, SIGNAL(modelReset()), this,
+          SLOT(invalidateSelectionCache()));
+}
+
+/*
+ * Columns hidden in table are reset by setModel()
+ */
+void ChildWidget::attachModel() {
+  if (DMESS > 10) qDebug() << Q_FUNC_INFO;
+  table->setModel(model);
   table->setSelectionModel(selectionModel);
+  selectionCacheValid = false;
   table->setSelectionBehavior(QAbstractItemView::SelectRows);
 
   table->hideColumn(5);
   table->hideColumn(6);
   table->hideColumn(7);
   table->hideColumn(8);
-  table->hideColumn(9);
+}
 
-  //TODO(zdenop): does it make sense to initialize this when changing/reloading page?
-  LineEditDelegate* leDelegate = new LineEditDelegate;
+/*
+ * Delegates belong to columns of table, so they are made only once and
+ * serve models of all pages.
+ */
+void ChildWidget::initDelegates() {
+  if (DMESS > 10) qDebug() << Q_FUNC_INFO;
+  LineEditDelegate* leDelegate = new LineEditDelegate(this);
   table->setItemDelegateForColumn(0, leDelegate);
 
   connect(leDelegate, SIGNAL(led_editstarted()), this,
@@ -402,7 +456,7 @@ void ChildWidget::initTable() {
   connect(leDelegate, SIGNAL(led_editfinished()), this,
           SLOT(letterEditFinished()));
 
-  SpinBoxDelegate* sbDelegate = new SpinBoxDelegate;
+  SpinBoxDelegate* sbDelegate = new SpinBoxDelegate(this);
   // TODO(zdenop): setMaximum for delegates after changing box
   table->setItemDelegateForColumn(1, sbDelegate);
   table->setItemDelegateForColumn(2, sbDelegate);
@@ -413,7 +467,7 @@ void ChildWidget::initTable() {
   connect(sbDelegate, SIGNAL(sbd_editingFinished()), this,
           SLOT(sbFinished()));
 
-  CheckboxDelegate* cbDelegate = new CheckboxDelegate;
+  CheckboxDelegate* cbDelegate = new CheckboxDelegate(this);
   table->setItemDelegateForColumn(6, cbDelegate);
   table->setItemDelegateForColumn(7, cbDelegate);
   table->setItemDelegateForColumn(8, cbDelegate);
@@ -434,6 +488,22 @@ void ChildWidget::readSettings() {
   }
   table->setFont(tableFont);
 
+  // Rows of the same height are laid out without measuring their text
+  uniformRowHeight = settings.value("GUI/UniformRowHeight", true).toBool();
+  QHeaderView::ResizeMode rowMode = QHeaderView::Interactive;
+  if (uniformRowHeight) {
+    QFont letterFont = tableFont;
+    letterFont.setBold(true);  // font flags change letter column only
+    table->verticalHeader()->setDefaultSectionSize(
+      QFontMetrics(letterFont).height() + 2 * kCellMargin);
+    rowMode = QHeaderView::Fixed;
+  }
+  #if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
+    table->verticalHeader()->setResizeMode(rowMode);
+  #else
+    table->verticalHeader()->setSectionResizeMode(rowMode);
+  #endif
+
   // Font for Image/balloons
   if (settings.contains("GUI/UseTheSameFont") &&
       settings.value("GUI/UseTheSameFont").toBool()) {
@@ -484,6 +554,17 @@ void ChildWidget::readSettings() {
     boxColor = Qt::green;
   }
 
+  boxLayer->setColors(boxColor, rectColor, rectFillColor);
+  // Cached pages would keep old colors
+  pageCache.clear();
+  pageCache.setMaxCost(
+    settings.value("Boxes/PageCacheMB", 256).toInt() * 1024);
+  // Older undo history is moved to a temporary file
+  qint64 undoMemory =
+    settings.value("Boxes/UndoMemoryMB", 16).toLongLong() * 1024 * 1024;
+  m_undostack.setMemoryLimit(undoMemory);
+  m_redostack.setMemoryLimit(undoMemory);
+
   if (settings.contains("GUI/BackgroundColor")) {
     backgroundColor = settings.value("GUI/BackgroundColor").value<QColor>();
   } else {
@@ -492,7 +573,8 @@ void ChildWidget::readSettings() {
   imageView->setBackgroundBrush(backgroundColor);
 
   if (model->rowCount() > 0) {
-    table->resizeRowsToContents();
+    if (!uniformRowHeight)
+      table->resizeRowsToContents();
     calculateTableWidth();
   }
 }
@@ -500,7 +582,9 @@ void ChildWidget::readSettings() {
 void ChildWidget::calculateTableWidth() {
   if (DMESS > 10) qDebug() << Q_FUNC_INFO;
   // set optimum size of table
-  table->resizeColumnsToContents();
+  for (int col = 0; col < model->columnCount(); ++col)
+    if (!table->isColumnHidden(col))
+      table->setColumnWidth(col, sampledColumnWidth(col));
   int tableVisibleWidth = 0;
   tableVisibleWidth += table->verticalHeader()->sizeHint().width();
 
@@ -517,6 +601,32 @@ void ChildWidget::calculateTableWidth() {
   splitterSizes << widgetWidth - tableVisibleWidth - this->handleWidth();
   setSizes(splitterSizes);
 }
+
+/*
+ * Width of column is measured only on kSampleRows rows spread over the
+ * whole page (and the header), so it does not depend on page size.
+ */
+int ChildWidget::sampledColumnWidth(int column) {
+  int width = table->horizontalHeader()->sectionSizeHint(column);
+  if (column >= BoxTableModel::Italic)
+    return width;  // check boxes
+
+  QFontMetrics metrics(table->font());
+  int rows = model->rowCount();
+  int step = qMax(1, rows / kSampleRows);
+  for (int row = 0; row < rows; row += step) {
+    QModelIndex index = model->index(row, column);
+    QVariant font = index.data(Qt::FontRole);
+    // font of letter has only its flags set
+    int textWidth = font.isValid()
+                    ? QFontMetrics(font.value<QFont>().resolve(table->font()))
+                      .width(index.data().toString())
+                    : metrics.width(index.data().toString());
+    width = qMax(width, textWidth + 2 * kCellMargin);
+  }
+  return width;
+}
+
 void ChildWidget::updateColWidthsOnSplitter(int /*pos*/, int /*index*/) {
   if (DMESS > 10) qDebug() << Q_FUNC_INFO;
   table->horizontalHeader()->resizeSections(QHeaderView::Stretch);
@@ -562,8 +672,7 @@ bool ChildWidget::loadImage(const QString& fileName) {
   imageHeight = image.height();
   imageWidth = image.width();
   setCurrentImageFile(fileName);
-  QString boxFileName = QFileInfo(fileName).path() + "/"  // QDir::separator()
-                        + QFileInfo(fileName).completeBaseName() + ".box";
+  QString boxFileName = ChildWidget::boxFileName(fileName);
 
   if (!QFile::exists(boxFileName)) {
       qCreateBoxes(boxFileName);
@@ -574,22 +683,26 @@ bool ChildWidget::loadImage(const QString& fileName) {
   setCurrentBoxFile(boxFileName);
   setFileWatcher(boxFileName);
   imageItem = imageScene->addPixmap(QPixmap::fromImage(image));
-  modified = false;
+  // Recovered journal holds changes not saved to box file yet
+  modified = !journal.isEmpty();
   emit modifiedChanged();
-  connect(model, SIGNAL(itemChanged(QStandardItem*)), this,
-          SLOT(emitBoxChanged()));
-  connect(model, SIGNAL(itemChanged(QStandardItem*)), this,
-          SLOT(documentWasModified()));
+  // Broken file was already checked by validateFile(), loaded boxes are
+  // checked on request (Edit > Validate boxes) unless enabled here
+  QSettings settings(QSettings::IniFormat, QSettings::UserScope,
+                     SETTING_ORGANIZATION, SETTING_APPLICATION);
+  if (settings.value("Boxes/Validate", false).toBool())
+    validateBoxes();
   return true;
 }
 
 bool ChildWidget::qCreateBoxes(const QString &boxFileName) {
   if (DMESS > 10) qDebug() << Q_FUNC_INFO;
   loadTable();
-  save(boxFileName);
+  // File must exist before it becomes current box file (and is watched)
+  bool ok = save(boxFileName) && waitForSave();
   modified = false;
   emit modifiedChanged();
-  return true;
+  return ok;
 }
 
 bool ChildWidget::makeBoxPage() {
@@ -610,12 +723,15 @@ bool ChildWidget::makeBoxPage() {
   if (str == "")
     return false;
 
-  QTextStream boxdata(&str);
-  readToVector(boxdata);
+  QByteArray data = str.toUtf8();
+  QBuffer boxdata(&data);
+  boxdata.open(QIODevice::ReadOnly);
+  readToVector(&boxdata);
   return true;
 }
 
 void ChildWidget::loadTable() {
+  pageCache.clear();  // document was read again
   bool showFontColumns = isFontColumnsShown();
   cleanTable();
   initTable();
@@ -627,49 +743,36 @@ void ChildWidget::loadTable() {
   }
 }
 
-bool ChildWidget::readToVector(QTextStream &boxdata) {
+bool ChildWidget::readToVector(QIODevice* boxdata) {
   if (DMESS > 10) qDebug() << Q_FUNC_INFO;
-  boxdata.setCodec("UTF-8");
-  QString data = boxdata.readAll();
-  QStringList lineBoxes = data.split(QRegExp("\n"),
-                                     QString::SkipEmptyParts);
-  QString pagePrev = "0";
-  QVector<QStringList> page;
-
-  for (int i = 0; i < lineBoxes.size(); ++i) {
-    QString line = lineBoxes.at(i);
-    QStringList box = line.split(" ");
-    if (box.size() == 7) {
-        if (line.startsWith(" "))
-            box.removeFirst ();  // tess2image generate also box for spaces
-    } else if (box.size() != 6) {
-      qDebug() << "box:" << box;
-      QMessageBox::warning(this, SETTING_APPLICATION,
-                           tr("File can not be loaded because of wrong "
-                              "(non tesseract-ocr 3.02) box "
-                              "file format at line '%1'! (box.size: %2)")
-                              .arg(i + 1).arg (box.size()));
-      QApplication::restoreOverrideCursor();
-      return false;
-    }
-
-    if (box[5] == pagePrev) {
-      page.append(box);
-    } else {
-      pagePrev = box[5];
-      pages.append(page);
-      page.clear();
-      page.append(box);
-    }
+  invalidateGlyphCounts();
+  if (!document.read(boxdata)) {
+    showDocumentError();
+    return false;
   }
-  pages.append(page);
   return true;
 }
 
+void ChildWidget::showDocumentError() {
+  if (document.errorLine() > 0) {
+    QMessageBox::warning(this, SETTING_APPLICATION,
+                         tr("File can not be loaded because of wrong "
+                            "(non tesseract-ocr 3.02) box "
+                            "file format at line '%1'! (box.size: %2)")
+                            .arg(document.errorLine())
+                            .arg(document.errorFieldCount()));
+  } else {
+    QMessageBox::warning(this, SETTING_APPLICATION,
+                         tr("Cannot read box data:\n%1.")
+                         .arg(document.errorString()));
+  }
+  QApplication::restoreOverrideCursor();
+}
+
 bool ChildWidget::fillTableData(int pageNum) {
   if (DMESS > 10) qDebug() << Q_FUNC_INFO;
 
-  if (pageNum > (pages.size() - 1)) {
+  if (pageNum > (document.pageCount() - 1)) {
     switch (QMessageBox::question(
               this,
               tr("Warning: Missing data!"),
@@ -690,7 +793,6 @@ bool ChildWidget::fillTableData(int pageNum) {
         break;
     }
   }
-  int row = 0;
   QApplication::setOverrideCursor(Qt::WaitCursor);
 
   // Stop some table features to improve update performance
@@ -700,57 +802,23 @@ bool ChildWidget::fillTableData(int pageNum) {
   table->setEditTriggers(QAbstractItemView::NoEditTriggers);
 
   // There could be no data for requested page e.g. makeboxpage failed.
-  if (pageNum >= pages.size()) {
+  if (pageNum >= document.pageCount()) {
     QApplication::restoreOverrideCursor();
     return false;
   }
 
-  QVector<QStringList> pageData = pages[pageNum];
-  for (int i = 0; i < pageData.size(); ++i) {
-    QFont letterFont;
-    QStringList pieces = pageData[i];
-    QString letter = pieces.value(0);
-    bool bold = false, italic = false, underline = false;
-    // formating is present only in case there are more than 2 letters
-    if (letter.at(0) == '@' && letter.size() > 1) {
-      bold = true;
-      letterFont.setBold(true);
-      letter.remove(0, 1);
-    }
-    if (letter.at(0) == '$' && letter.size() > 1) {
-      italic = true;
-      letterFont.setItalic(true);
-      letter.remove(0, 1);
-    }
-    if (letter.at(0) == '\'' && letter.size() > 1) {
-      underline = true;
-      letterFont.setUnderline(true);
-      letter.remove(0, 1);
-    }
-    int left = pieces.value(1).toInt();
-    int bottom = imageHeight - pieces.value(2).toInt();
-    int right = pieces.value(3).toInt();
-    int top = imageHeight - pieces.value(4).toInt();
-    int page = pieces.value(5).toInt();
-
-    model->insertRow(row);
-    model->setData(model->index(row, 0, QModelIndex()), letterFont,
-                   Qt::FontRole);
-    model->setData(model->index(row, 0, QModelIndex()), letter);
-    model->setData(model->index(row, 1, QModelIndex()), left);
-    model->setData(model->index(row, 2, QModelIndex()), bottom);
-    model->setData(model->index(row, 3, QModelIndex()), right);
-    model->setData(model->index(row, 4, QModelIndex()), top);
-    model->setData(model->index(row, 5, QModelIndex()), page);
-    model->setData(model->index(row, 6, QModelIndex()), italic);
-    model->setData(model->index(row, 7, QModelIndex()), bold);
-    model->setData(model->index(row, 8, QModelIndex()), underline);
-    createModelItemBox(row);
-    row++;
-  }
+  document.loadPage(pageNum);
+  journalBlocked = true;
+  BoxColumns columns;
+  document.columns(pageNum, &columns);
+  // Model serves cells from columns, page is inserted at once
+  columns.flipVertical(imageHeight);
+  model->setBoxes(columns);
+  journalBlocked = false;
 
   // Set table features
-  table->resizeRowsToContents();
+  if (!uniformRowHeight)
+    table->resizeRowsToContents();
   table->setCornerButtonEnabled(true);
   table->setWordWrap(true);
   calculateTableWidth();
@@ -763,8 +831,43 @@ bool ChildWidget::fillTableData(int pageNum) {
   return true;
 }
 
+QString ChildWidget::boxFileName(const QString& imageFile) {
+  QString boxFile = QFileInfo(imageFile).path() + "/"  // QDir::separator()
+                    + QFileInfo(imageFile).completeBaseName() + ".box";
+  if (!QFile::exists(boxFile) && QFile::exists(boxFile + ".gz"))
+    return boxFile + ".gz";
+  return boxFile;
+}
+
 bool ChildWidget::loadBoxes(const QString& fileName) {
   if (DMESS > 10) qDebug() << Q_FUNC_INFO;
+  QSettings settings(QSettings::IniFormat, QSettings::UserScope,
+                     SETTING_ORGANIZATION, SETTING_APPLICATION);
+  if (BoxGzip::isGzipFile(fileName))
+    return loadGzipBoxes(fileName);
+  // Mapped box file is not copied to memory, only edited rows are
+  if (settings.value("Boxes/MemoryMap", true).toBool()) {
+    int threads = 1;
+    if (settings.value("Boxes/ParallelParse", true).toBool())
+      threads = QThread::idealThreadCount();
+    // Lazy mode indexes rows of page only when page is shown
+    document.setLazy(settings.value("Boxes/LazyPages", true).toBool());
+    document.setPageBudget(
+      settings.value("Boxes/PageBudgetMB", 64).toLongLong() * 1024 * 1024);
+    // Optional <box>.qbecache with page index makes reopen instant
+    document.setCacheEnabled(settings.value("Boxes/Cache", false).toBool());
+    if (document.map(fileName, threads)) {
+      recoverJournal(fileName);
+      return fillTableData(0);
+    }
+    if (document.errorLine() > 0) {
+      if (!validateFile(fileName))
+        showDocumentError();
+      return false;
+    }
+    // mapping is not possible (e.g. empty file) => read it
+  }
+
   QFile file(fileName);
 
   if (!file.open(QFile::ReadOnly | QFile::Text)) {
@@ -773,10 +876,12 @@ bool ChildWidget::loadBoxes(const QString& fileName) {
                            file.errorString()));
     return false;
   }
-  QTextStream boxdata(&file);
-  if (!readToVector(boxdata)) {
+  if (!document.read(&file)) {
+    if (document.errorLine() == 0 || !validateFile(fileName))
+      showDocumentError();
     return false;
   }
+  recoverJournal(fileName);
   if (!fillTableData(0)) {
     return false;
   }
@@ -784,6 +889,29 @@ bool ChildWidget::loadBoxes(const QString& fileName) {
   return true;
 }
 
+/*
+ * Inflate .box.gz straight to the tokenizer
+ */
+bool ChildWidget::loadGzipBoxes(const QString& fileName) {
+  if (DMESS > 10) qDebug() << Q_FUNC_INFO;
+  QFile file(fileName);
+  BoxGzip gzip(&file);
+  if (!file.open(QFile::ReadOnly) || !gzip.open(QIODevice::ReadOnly)) {
+    QMessageBox::warning(this, SETTING_APPLICATION,
+                         tr("Cannot read file %1:\n%2.").arg(fileName).arg(
+                           file.isOpen() ? gzip.errorString()
+                                         : file.errorString()));
+    return false;
+  }
+  if (!document.read(&gzip)) {
+    if (document.errorLine() == 0 || !validateFile(fileName))
+      showDocumentError();
+    return false;
+  }
+  recoverJournal(fileName);
+  return fillTableData(0);
+}
+
 void ChildWidget::setFileWatcher(const QString & fileName) {
   if (DMESS > 10) qDebug() << Q_FUNC_INFO;
   if (fileWatcher) {
@@ -798,6 +926,19 @@ void ChildWidget::setFileWatcher(const QString & fileName) {
 
 void ChildWidget::slotfileChanged(const QString &fileName) {
   if (DMESS > 10) qDebug() << Q_FUNC_INFO;
+  // Rows not yet edited are views into mapped file. If other program
+  // rewrote it in place, they already show its bytes - there is nothing
+  // of ours left to keep, so file has to be read again.
+  if (document.isChangedInPlace()) {
+    QMessageBox::warning(this, SETTING_APPLICATION,
+                         tr("File '%1' was rewritten outside of %2 and " \
+                            "will be reloaded.\nUnsaved changes are lost.")
+                         .arg(fileName).arg(SETTING_APPLICATION));
+    reload(fileName);
+    return;
+  }
+  // File was replaced or removed: mapping still holds our old content
+  document.detach();
   if (!QFile::exists(fileName)) {
       switch (QMessageBox::question(
                 this,
@@ -844,15 +985,21 @@ void ChildWidget::slotfileChanged(const QString &fileName) {
 }
 
 bool ChildWidget::reload(const QString& fileName) {
+  waitForSave();
   if (boxesVisible) {
     drawBoxes();
   }
-  deleteModelItemBox(table->currentIndex().row());
   bool showFontColumns = isFontColumnsShown();
   model->clear();
   delete selectionModel;
   delete model;
-  pages.clear();
+  pageCache.clear();
+  document.clear();
+  invalidateGlyphCounts();
+  journal.discard();
+  // glyph ids of undo items are not valid anymore
+  m_undostack.clear();
+  m_redostack.clear();
 
 
   initTable();
@@ -872,6 +1019,7 @@ bool ChildWidget::reloadImg() {
   if (DMESS > 10) qDebug() << Q_FUNC_INFO;
   imageScene->removeItem(static_cast<QGraphicsItem*>(imageItem));
   delete imageItem;
+  pageCache.clear();  // images of other pages could be changed too
   QImage image;
   if (pageWidget->isHidden()) {  // one page - QImage is ok
     image.load(imageFile);
@@ -886,47 +1034,73 @@ bool ChildWidget::reloadImg() {
 }
 
 bool ChildWidget::save(const QString& fileName) {
-  // TODO(zdenop): support multipage!
   if (DMESS > 10) qDebug() << Q_FUNC_INFO;
+  // One save at time
+  waitForSave();
 
   storePage();
-  QFile file(fileName);
-  if (!file.open(QFile::WriteOnly)) {
-    QMessageBox::warning(
-      this,
-      SETTING_APPLICATION,
-      tr("Cannot write file %1:\n%2.").arg(fileName).arg(file.errorString()));
-    return false;
-  }
 
+  // Our own write must not be reported as external change
   if (fileWatcher) {
     delete fileWatcher;
     fileWatcher = 0;
   }
 
-  QTextStream out(&file);
-  out.setCodec("UTF-8");
+  // Snapshot is serialized and written in background, editing goes on
+  saveGeneration = editGeneration;
+  saveJournalPosition = journal.position();
+  saveJob = document.saveJob(fileName);
+  connect(saveJob, SIGNAL(finished()), this, SLOT(slotSaveFinished()));
+  savePool.start(saveJob);
+  return true;
+}
+
+bool ChildWidget::waitForSave() {
+  if (DMESS > 10) qDebug() << Q_FUNC_INFO;
+  if (!saveJob)
+    return true;
   QApplication::setOverrideCursor(Qt::WaitCursor);
+  savePool.waitForDone();
+  QApplication::restoreOverrideCursor();
+  return finishSave();
+}
 
-  for (int i = 0; i < pages.size(); ++i) {
-    QVector<QStringList> page = pages[i];
-    for (int j = 0; j < page.size(); ++j) {
-      QStringList box = page[j];
-      for ( QStringList::Iterator it = box.begin(); it != box.end(); ++it ) {
-        out << *it;
-        if (it != (box.end() - 1))
-          out << " ";
-      }
-      out << "\n";
-    }
-  }
+void ChildWidget::slotSaveFinished() {
+  if (DMESS > 10) qDebug() << Q_FUNC_INFO;
+  // Job could be already finished by waitForSave()
+  if (!saveJob || sender() != saveJob)
+    return;
+  finishSave();
+}
 
-  file.close();
-  QApplication::restoreOverrideCursor();
+bool ChildWidget::finishSave() {
+  if (DMESS > 10) qDebug() << Q_FUNC_INFO;
+  BoxSaveJob* job = saveJob;
+  saveJob = 0;
+  QString fileName = job->fileName();
+  bool ok = document.finishSave(job);
+  job->deleteLater();
 
-  modified = false;
-  emit modifiedChanged();
+  if (!ok) {
+    QMessageBox::warning(
+      this,
+      SETTING_APPLICATION,
+      tr("Cannot write file %1:\n%2.").arg(fileName)
+      .arg(document.errorString()));
+    if (!boxFile.isEmpty())
+      setFileWatcher(boxFile);
+    return false;
+  }
+
+  // Edits made during save are not on disk yet
+  if (QFileInfo(fileName).canonicalFilePath() == boxFile)
+    journal.compact(saveJournalPosition);
+  if (editGeneration == saveGeneration) {
+    modified = false;
+    emit modifiedChanged();
+  }
   setFileWatcher(fileName);
+  emit statusBarMessage(tr("File saved"));
   return true;
 }
 
@@ -937,37 +1111,31 @@ bool ChildWidget::splitToFeatureBF(const QString& fileName) {
   QApplication::setOverrideCursor(Qt::WaitCursor);
   QString normBoxes = "", boldBoxes = "", italicBoxes = "", boldItaBoxes = "";
   QString underBoxes = "";
-  for (int row = 0; row < model->rowCount(); ++row) {
-    QString letter = model->index(row, 0).data().toString();
-    int left = model->index(row, 1).data().toInt();
-    int bottom = model->index(row, 2).data().toInt();
-    int right = model->index(row, 3).data().toInt();
-    int top = model->index(row, 4).data().toInt();
-    int page = model->index(row, 5).data().toInt();
-    bool italic = model->index(row, 6).data().toBool();
-    bool bold = model->index(row, 7).data().toBool();
-    bool underline = model->index(row, 8).data().toBool();
+  // table holds current page; it is written in file coordinates, font
+  // prefixes are not written
+  const BoxColumns& boxes = model->boxes();
+  const BoxStore& store = document.store();
+  for (int row = 0; row < boxes.size(); ++row) {
+    QString box = QString::fromUtf8(BoxSerializer::formatRow(
+                    store.glyph(boxes.glyph.at(row)), boxes.left.at(row),
+                    imageHeight - boxes.bottom.at(row), boxes.right.at(row),
+                    imageHeight - boxes.top.at(row), boxes.page.at(row))) +
+                  "\n";
+    int flags = boxes.flags.at(row);
+    bool italic = flags & BoxStore::Italic;
+    bool bold = flags & BoxStore::Bold;
+    bool underline = flags & BoxStore::Underline;
 
     if (bold && !italic) {
-      boldBoxes += QString("%1 %2 %3 %4 %5 %6\n").arg(letter).arg(left)
-                   .arg(imageHeight - bottom).arg(right).arg(imageHeight - top)
-                   .arg(page);
+      boldBoxes += box;
     } else if (italic && !bold) {
-      italicBoxes += QString("%1 %2 %3 %4 %5 %6\n").arg(letter).arg(left)
-                     .arg(imageHeight - bottom).arg(right)
-                     .arg(imageHeight - top).arg(page);
+      italicBoxes += box;
     } else if (italic && bold) {
-      boldItaBoxes += QString("%1 %2 %3 %4 %5 %6\n").arg(letter).arg(left)
-                      .arg(imageHeight - bottom).arg(right)
-                      .arg(imageHeight - top).arg(page);
+      boldItaBoxes += box;
     } else if (underline) {
-      underBoxes += QString("%1 %2 %3 %4 %5 %6\n").arg(letter).arg(left)
-                    .arg(imageHeight - bottom).arg(right).arg(imageHeight - top)
-                    .arg(page);
+      underBoxes += box;
     } else {
-      normBoxes += QString("%1 %2 %3 %4 %5 %6\n").arg(letter).arg(left)
-                   .arg(imageHeight - bottom).arg(right).arg(imageHeight - top)
-                   .arg(page);
+      normBoxes += box;
     }
   }
 
@@ -1088,10 +1256,12 @@ bool ChildWidget::importSPLToChild(const QString& fileName) {
   QApplication::setOverrideCursor(Qt::WaitCursor);
   QString line;
   int row = 0;
+  beginEdit();  // whole import is one change
   do {
     line = in.readLine();
     if (!line.isEmpty()) {
       if (row > model->rowCount()) {
+        commit();
         QMessageBox::warning(this, SETTING_APPLICATION,
                              tr("There are more symbols in import file than " \
                                 "boxes!\nRest of symbols are ignored."));
@@ -1103,6 +1273,7 @@ bool ChildWidget::importSPLToChild(const QString& fileName) {
       row++;
     }
   } while (!line.isEmpty());
+  commit();
 
   if (row < model->rowCount()) {
     QMessageBox::warning(this, SETTING_APPLICATION,
@@ -1113,9 +1284,6 @@ bool ChildWidget::importSPLToChild(const QString& fileName) {
   file.close();
   QApplication::restoreOverrideCursor();
 
-  modified = true;
-  emit modifiedChanged();
-
   return true;
 }
 
@@ -1192,15 +1360,14 @@ bool ChildWidget::importTextToChild(const QString& fileName) {
                             "number of boxes!"));
   }
 
+  beginEdit();  // whole import is one change
   for (int i = 0; i < symbols.size(); ++i) {
     model->setData(model->index(i, 0, QModelIndex()), symbols.at(i));
   }
+  commit();
 
   QApplication::restoreOverrideCursor();
 
-  modified = true;
-  emit modifiedChanged();
-
   return true;
 }
 
@@ -1241,12 +1408,15 @@ bool ChildWidget::exportTxt(const int& eType, const QString& fileName) {
   int wordSpace = settings.value("Text/WordSpace").toInt();
   int paraIndent = settings.value("Text/ParagraphIndent").toInt();
 
-  for (int row = 0; row < model->rowCount(); ++row) {
-    QString letter = model->index(row, 0).data().toString();
-    int left = model->index(row, 1).data().toInt();
-    int bottom = model->index(row, 2).data().toInt();
-    int right = model->index(row, 3).data().toInt();
-    int top = model->index(row, 4).data().toInt();
+  // display coordinates (origin in top left corner) as in table
+  const BoxColumns& boxes = model->boxes();
+  const BoxStore& store = document.store();
+  for (int row = 0; row < boxes.size(); ++row) {
+    QString letter = store.glyph(boxes.glyph.at(row));
+    int left = boxes.left.at(row);
+    int bottom = boxes.bottom.at(row);
+    int right = boxes.right.at(row);
+    int top = boxes.top.at(row);
 
     if (last_bottom == -1)
       last_bottom = top;
@@ -1376,90 +1546,42 @@ bool ChildWidget::isDrawRect() {
 
 void ChildWidget::setItalic(bool v) {
   if (DMESS > 10) qDebug() << Q_FUNC_INFO;
-  QModelIndexList indexes = table->selectionModel()->selectedRows();
-  QModelIndex index;
-  QFont letterFont;
-
-  foreach(index, indexes) {
-    // IsItalic?
-    bool current = model->index(index.row(), 6).data().toBool();
-    if (current != v) {
-      UndoItem ui;
-      ui.m_eop = euoChange;
-      ui.m_origrow = index.row();
-
-      for (int ii = 0; ii < model->columnCount(); ii++)
-        ui.m_vdata[ii] = model->index(ui.m_origrow, ii).data();
-
-      m_undostack.push(ui);
-
-      letterFont = model->data(model->index(index.row(), 0, QModelIndex()),
-                               Qt::FontRole).value<QFont>();
-      letterFont.setItalic(v);
-      model->setData(model->index(index.row(), 0, QModelIndex()), letterFont,
-                     Qt::FontRole);
-      model->setData(model->index(index.row(), 6, QModelIndex()), v);
-    }
-  }
+  setSelectedFlag(BoxTableModel::Italic, v);
 }
 
 void ChildWidget::setBolded(bool v) {
   if (DMESS > 10) qDebug() << Q_FUNC_INFO;
-  QModelIndexList indexes = table->selectionModel()->selectedRows();
-  QModelIndex index;
-  QFont letterFont;
-
-  foreach(index, indexes) {
-    // IsBool?
-    bool current = model->index(index.row(), 7).data().toBool();
-    if (current != v) {
-      UndoItem ui;
-      ui.m_eop = euoChange;
-      ui.m_origrow = index.row();
-
-      for (int ii = 0; ii < model->columnCount(); ii++)
-        ui.m_vdata[ii] = model->index(ui.m_origrow, ii).data();
-
-      m_undostack.push(ui);
-
-      letterFont = model->data(model->index(index.row(), 0, QModelIndex()),
-                               Qt::FontRole).value<QFont>();
-      letterFont.setBold(v);
-
-      model->setData(model->index(index.row(), 0, QModelIndex()), letterFont,
-                     Qt::FontRole);
-      model->setData(model->index(index.row(), 7, QModelIndex()), v);
-    }
-  }
+  setSelectedFlag(BoxTableModel::Bold, v);
 }
 
 void ChildWidget::setUnderline(bool v) {
   if (DMESS > 10) qDebug() << Q_FUNC_INFO;
-  QModelIndexList indexes = table->selectionModel()->selectedRows();
-  QModelIndex index;
-  QFont letterFont;
-
-  foreach(index, indexes) {
-    // IsUnderLine?
-    bool current = model->index(index.row(), 8).data().toBool();
-    if (current != v) {
-      UndoItem ui;
-      ui.m_eop = euoChange;
-      ui.m_origrow = index.row();
-
-      for (int ii = 0; ii < model->columnCount(); ii++)
-        ui.m_vdata[ii] = model->index(ui.m_origrow, ii).data();
-
-      m_undostack.push(ui);
+  setSelectedFlag(BoxTableModel::Underline, v);
+}
 
-      letterFont = model->data(model->index(index.row(), 0, QModelIndex()),
-                               Qt::FontRole).value<QFont>();
-      letterFont.setUnderline(v);
-      model->setData(model->index(index.row(), 0, QModelIndex()), letterFont,
-                     Qt::FontRole);
-      model->setData(model->index(index.row(), 8, QModelIndex()), v);
+/*
+ * Only flag column is set, model derives font of letter from flags.
+ * Changed rows keep their old boxes in one undo item.
+ */
+void ChildWidget::setSelectedFlag(int column, bool on) {
+  const QVector<int>& rows = selectedRowNumbers();
+  UndoItem ui;
+  ui.m_eop = euoChangeRows;
+  for (int i = 0; i < rows.size(); ++i) {
+    if (model->index(rows[i], column).data().toBool() != on) {
+      ui.m_rows.append(rows[i]);
+      ui.m_boxes.append(model->boxes(), rows[i]);
     }
   }
+  if (ui.m_rows.isEmpty())
+    return;
+  ui.m_origrow = ui.m_rows.front();
+
+  beginEdit();
+  for (int i = 0; i < ui.m_rows.size(); ++i)
+    model->setData(model->index(ui.m_rows[i], column), on);
+  m_undostack.push(ui);
+  commit();
 }
 
 /*
@@ -1521,7 +1643,7 @@ void ChildWidget::zoomIn() {
   if (DMESS > 10) qDebug() << Q_FUNC_INFO;
   imageView->scale(1.2, 1.2);
   if (selectionModel->hasSelection())
-    imageView->ensureVisible(modelItemBox());
+    imageView->ensureVisible(QRectF(modelItemBox()));
   setZoomStatus();
 }
 
@@ -1529,7 +1651,7 @@ void ChildWidget::zoomOut() {
   if (DMESS > 10) qDebug() << Q_FUNC_INFO;
   imageView->scale(1 / 1.2, 1 / 1.2);
   if (selectionModel->hasSelection())
-    imageView->ensureVisible(modelItemBox());
+    imageView->ensureVisible(QRectF(modelItemBox()));
   setZoomStatus();
 }
 
@@ -1557,7 +1679,7 @@ void ChildWidget::zoomToHeight() {
 
   setZoom(zoomFactor);
   if (selectionModel->hasSelection())
-    imageView->ensureVisible(modelItemBox());
+    imageView->ensureVisible(QRectF(modelItemBox()));
 }
 
 void ChildWidget::zoomToWidth() {
@@ -1567,24 +1689,24 @@ void ChildWidget::zoomToWidth() {
 
   setZoom(zoomFactor);
   if (selectionModel->hasSelection())
-    imageView->ensureVisible(modelItemBox());
+    imageView->ensureVisible(QRectF(modelItemBox()));
 }
 
 void ChildWidget::zoomOriginal() {
   if (DMESS > 10) qDebug() << Q_FUNC_INFO;
   setZoom(1);
   if (selectionModel->hasSelection())
-    imageView->ensureVisible(modelItemBox());
+    imageView->ensureVisible(QRectF(modelItemBox()));
 }
 
 void ChildWidget::zoomToSelection() {
   if (DMESS > 10) qDebug() << Q_FUNC_INFO;
   if (selectionModel->hasSelection()) {
-    imageView->fitInView(modelItemBox(), Qt::KeepAspectRatio);
+    imageView->fitInView(QRectF(modelItemBox()), Qt::KeepAspectRatio);
     imageView->scale(1 / 1.1, 1 / 1.1);    // make small border
     if (selectionModel->hasSelection())
-      imageView->ensureVisible(modelItemBox());
-    imageView->centerOn(modelItemBox());
+      imageView->ensureVisible(QRectF(modelItemBox()));
+    imageView->centerOn(QRectF(modelItemBox()).center());
     setZoomStatus();
   }
 }
@@ -1676,61 +1798,66 @@ void ChildWidget::drawRectangle(bool checked) {
   emit drawRectangleChoosen();
 }
 
-QGraphicsRectItem* ChildWidget::modelItemBox(int row) {
+QRect ChildWidget::modelItemBox(int row) {
   if (DMESS > 10) qDebug() << Q_FUNC_INFO;
   if (selectionModel->hasSelection()) {
     if (row == -1)
-      row = table->selectionModel()->selectedRows().last().row();
-    return model->index(row, 9).data().value<QGraphicsRectItem*>();
+      row = lastSelectedRow();
+    if (row < 0)
+      return QRect();
+    return boxLayer->box(row);
   } else {
-    return NULL;
+    return QRect();
   }
 }
 
-QGraphicsRectItem* ChildWidget::createModelItemBox(int row) {
-  if (DMESS > 10) qDebug() << Q_FUNC_INFO;
-  int left = model->index(row, 1).data().toInt();
-  int bottom = model->index(row, 2).data().toInt();
-  int right = model->index(row, 3).data().toInt();
-  int top = model->index(row, 4).data().toInt();
-  QGraphicsRectItem* rectItem =
-    imageScene->addRect(left, top, right - left, bottom - top, QPen(boxColor));
-  rectItem->setZValue(2);
-  rectItem->hide();
+QRect ChildWidget::modelRect(int row) {
+  const BoxColumns& boxes = model->boxes();
+  int left = boxes.left.at(row);
+  int top = boxes.top.at(row);
+  return QRect(left, top, boxes.right.at(row) - left,
+               boxes.bottom.at(row) - top);
+}
 
-  model->setData(model->index(row, 9), QVariant::fromValue(rectItem));
+/*
+ * Box layer mirrors rows of model, so every row change of table (edit,
+ * undo, page change) is shown on image.
+ */
+void ChildWidget::layerRowsInserted(const QModelIndex& parent, int first,
+                                    int last) {
+  if (parent.isValid())
+    return;
+  QVector<QRect> boxes;
+  boxes.reserve(last - first + 1);
+  for (int row = first; row <= last; ++row)
+    boxes.append(modelRect(row));
+  boxLayer->insertBoxes(first, boxes);
+}
 
-  return rectItem;
+void ChildWidget::layerRowsRemoved(const QModelIndex& parent, int first,
+                                   int last) {
+  if (parent.isValid())
+    return;
+  boxLayer->removeBoxes(first, last - first + 1);
 }
 
-void ChildWidget::updateModelItemBox(int row) {
-  if (DMESS > 10) qDebug() << Q_FUNC_INFO;
-  int left = model->index(row, 1).data().toInt();
-  int bottom = model->index(row, 2).data().toInt();
-  int right = model->index(row, 3).data().toInt();
-  int top = model->index(row, 4).data().toInt();
-  modelItemBox(row)->setRect(left, top, right - left, bottom - top);
+void ChildWidget::layerDataChanged(const QModelIndex& topLeft,
+                                   const QModelIndex& bottomRight) {
+  if (topLeft.column() > BoxTableModel::Top ||
+      bottomRight.column() < BoxTableModel::Left)
+    return;
+  for (int row = topLeft.row(); row <= bottomRight.row(); ++row)
+    boxLayer->setBox(row, modelRect(row));
 }
 
-void ChildWidget::deleteModelItemBox(int row) {
-  if (DMESS > 10) qDebug() << Q_FUNC_INFO;
-  // we can not use modelItemBox(row) because we clear selections...
-  QGraphicsRectItem* rectItem =
-          model->index(row, 9).data().value<QGraphicsRectItem*>();
-  imageScene->removeItem(rectItem);
-  delete rectItem;
+void ChildWidget::layerReset() {
+  boxLayer->clear();
 }
 
 void ChildWidget::drawBoxes() {
   if (DMESS > 10) qDebug() << Q_FUNC_INFO;
   boxesVisible = !boxesVisible;
-  // workaround:  modelItemBox(row) requires selection to not segfault
-  if (!selectionModel->hasSelection())
-    table->setCurrentIndex(model->index(0, 0));
-  for (int row = 0; row < model->rowCount(); ++row)
-    modelItemBox(row)->setVisible(boxesVisible);
-  if (boxesVisible)
-    updateSelectionRects();
+  boxLayer->setBoxesVisible(boxesVisible);
 }
 
 void ChildWidget::mousePressEvent(QMouseEvent* event) {
@@ -1753,19 +1880,13 @@ void ChildWidget::mousePressEvent(QMouseEvent* event) {
     rubberBand->show();
     grabMouse();
   } else if (event->modifiers() == Qt::NoModifier) {  // BB click selection
-    for (int row = 0; row < model->rowCount(); ++row) {
-      int left = model->index(row, 1).data().toInt();
-      int bottom = model->index(row, 2).data().toInt();
-      int right = model->index(row, 3).data().toInt();
-      int top = model->index(row, 4).data().toInt();
-      QPointF mouseCoordinates = imageView->mapToScene(event->pos());
-      if ((left <= (mouseCoordinates.x() - zoomedOffset) &&
-           (mouseCoordinates.x() - zoomedOffset) <= right) &&
-          (top <= mouseCoordinates.y()) &&
-          (mouseCoordinates.y() <= bottom)) {
-        table->setCurrentIndex(model->index(row, 0));
-        table->setFocus();
-      }
+    QPointF mouseCoordinates = imageView->mapToScene(event->pos());
+    mouseCoordinates.rx() -= zoomedOffset;
+    // smallest of overlapping boxes
+    int row = boxLayer->boxAt(mouseCoordinates);
+    if (row >= 0) {
+      table->setCurrentIndex(model->index(row, 0));
+      table->setFocus();
     }
   }  // else (BB selection)
 }
@@ -1792,6 +1913,17 @@ void ChildWidget::mouseMoveEvent(QMouseEvent* event) {
     botright.setY(rbCurPoint.y());
   }
   rubberBand->setGeometry(QRect(topleft, botright));
+
+  // Live preview of boxes that release of button selects
+  if (rubberBand->isVisible())
+    boxLayer->setPreview(rubberBandRows());
+}
+
+QVector<int> ChildWidget::rubberBandRows() {
+  QRect rect(rubberBand->pos(), rubberBand->size());
+  QPoint topleft = imageView->mapToScene(rect.topLeft()).toPoint();
+  QPoint botright = imageView->mapToScene(rect.bottomRight()).toPoint();
+  return boxLayer->boxesCenteredIn(QRectF(topleft, botright));
 }
 
 void ChildWidget::mouseReleaseEvent(QMouseEvent* /*event*/) {
@@ -1799,40 +1931,28 @@ void ChildWidget::mouseReleaseEvent(QMouseEvent* /*event*/) {
   setCursor(Qt::ArrowCursor);
   releaseMouse();
   rubberBand->hide();
+  boxLayer->setPreview(QVector<int>());
 
   // If a Ctrl+Click - toggle
   if (!rubberBand->size().isValid() || (rubberBand->size().width() == 0 &&
                                         rubberBand->size().height() == 0)) {
     QPoint pos = imageView->mapToScene(rubberBand->pos()).toPoint();
-    for (int row = 0; row < model->rowCount(); ++row) {
-      int left = model->index(row, 1).data().toInt();
-      int bottom = model->index(row, 2).data().toInt();
-      int right = model->index(row, 3).data().toInt();
-      int top = model->index(row, 4).data().toInt();
-
-      if (left <= pos.x() && pos.x() <= right &&
-              top <= pos.y() && pos.y() <= bottom) {
-        table->selectionModel()->select(model->index(row, 0),
-                                        QItemSelectionModel::Toggle |
-                                        QItemSelectionModel::Rows);
-        break;
-      }
-    }  // for row
+    int row = boxLayer->boxAt(pos);
+    if (row >= 0)
+      table->selectionModel()->select(model->index(row, 0),
+                                      QItemSelectionModel::Toggle |
+                                      QItemSelectionModel::Rows);
   // end of if click
   } else {  // If rubber band - add to selection
-    QRect rect(rubberBand->pos(), rubberBand->size());
-    QPoint topleft = imageView->mapToScene(rect.topLeft()).toPoint();
-    QPoint botright = imageView->mapToScene(rect.bottomRight()).toPoint();
+    QVector<int> rows = rubberBandRows();
+    // Runs of consecutive rows (usually whole lines) are one range each
     QItemSelection selection;
-    for (int row = 0; row < model->rowCount(); ++row) {
-      int cx = (model->index(row, 1).data().toInt() +
-                model->index(row, 3).data().toInt())/2;
-      int cy = (model->index(row, 2).data().toInt() +
-                model->index(row, 4).data().toInt())/2;
-
-      if (cx >= topleft.x() && cx <= botright.x() && cy >= topleft.y() &&
-              cy <= botright.y())
-        selection.push_back(QItemSelectionRange(model->index(row, 0)));
+    for (int i = 0; i < rows.size(); ++i) {
+      int first = rows.at(i);
+      while (i + 1 < rows.size() && rows.at(i + 1) == rows.at(i) + 1)
+        ++i;
+      selection.append(QItemSelectionRange(model->index(first, 0),
+                                           model->index(rows.at(i), 0)));
     }
     table->selectionModel()->select(selection, QItemSelectionModel::Select |
                                     QItemSelectionModel::Rows);
@@ -1842,11 +1962,10 @@ void ChildWidget::mouseReleaseEvent(QMouseEvent* /*event*/) {
   updateSelectionRects();
 
   // Focus the last symbol in the selection
-  if (!table->selectionModel()->hasSelection() &&
-      table->selectionModel()->selection().size() > 0)
-    table->selectionModel()->setCurrentIndex(
-      table->selectionModel()->selectedRows().last(),
-      QItemSelectionModel::NoUpdate);
+  int lastRow = lastSelectedRow();
+  if (!table->selectionModel()->hasSelection() && lastRow >= 0)
+    table->selectionModel()->setCurrentIndex(model->index(lastRow, 0),
+                                             QItemSelectionModel::NoUpdate);
 }
 
 bool ChildWidget::eventFilter(QObject* object, QEvent* event) {
@@ -1911,6 +2030,14 @@ void ChildWidget::moveSymbolRow(int direction) {
   if (currentRow < 0)
     return;
 
+  // Selected block of rows moves up/down as a whole
+  QVector<int> rows = selectedRowNumbers();
+  if (abs(direction) == 1 && rows.size() > 1 &&
+      rows.back() - rows.front() + 1 == rows.size()) {
+    moveRowBlock(rows.front(), rows.back(), direction);
+    return;
+  }
+
   // check top/bottom movements
   if ((direction + currentRow < 0) ||
      (direction + currentRow + 1 > model->rowCount())) {
@@ -1918,23 +2045,21 @@ void ChildWidget::moveSymbolRow(int direction) {
     emit statusBarMessage(message);
     return;
   } else {
+    beginEdit();
     if (abs(direction) == 1) {  // This works only for moveUp/moveDown!!!
       UndoItem ui;
       ui.m_eop = euoReplace;
       ui.m_origrow = currentRow;
       ui.m_extrarow = currentRow + direction;
 
-      for (int j = 0; j < model->columnCount() - 1; j++) {
+      for (int j = 0; j < model->columnCount(); j++) {
         ui.m_vdata[j] = model->index(currentRow, j).data();
         ui.m_vextradata[j] = model->index(ui.m_extrarow, j).data();
-
-        model->setData(model->index(ui.m_extrarow, j), ui.m_vdata[j]);
-        model->setData(model->index(ui.m_origrow, j), ui.m_vextradata[j]);
       }
+      model->setRow(ui.m_extrarow, ui.m_vdata);
+      model->setRow(ui.m_origrow, ui.m_vextradata);
 
       m_undostack.push(ui);
-      updateModelItemBox(ui.m_extrarow);
-      updateModelItemBox(ui.m_origrow);
       // activate new row
       table->setCurrentIndex(model->index(ui.m_extrarow, 0));
     } else {
@@ -1951,26 +2076,62 @@ void ChildWidget::moveSymbolRow(int direction) {
         currentRow++;
       model->insertRow(newRow);
 
-      for (int i = 0; i < (model->columnCount() - 1); ++i) {
+      for (int i = 0; i < model->columnCount(); ++i)
         ui.m_vdata[i] = model->index(currentRow, i).data();
-        model->setData(model->index(newRow, i),
-                       model->index(currentRow, i).data());
-      }
+      model->setRow(newRow, ui.m_vdata);
       m_undostack.push(ui);
 
-      QGraphicsRectItem* rectItem = createModelItemBox(newRow);
       // activate new row
       table->setCurrentIndex(model->index(newRow, 0));
-      if (boxesVisible)
-        rectItem->show();
       // delete original row
       model->removeRow(currentRow);
     }
     updateSelectionRects();
-    emit modifiedChanged();
+    commit();
   }
 }
 
+/*
+ * Moving block by one row is the same as moving the row next to it to the
+ * other side of block, so it is an ordinary euoMove of one row.
+ */
+void ChildWidget::moveRowBlock(int first, int last, int direction) {
+  if (DMESS > 10) qDebug() << Q_FUNC_INFO;
+  int row = direction < 0 ? first - 1 : last + 1;
+  if (row < 0 || row >= model->rowCount()) {
+    emit statusBarMessage(tr("Non existing destination row!"));
+    return;
+  }
+
+  UndoItem ui;
+  ui.m_eop = euoMove;
+  ui.m_origrow = row;
+  ui.m_extrarow = direction < 0 ? last : first;
+  for (int i = 0; i < model->columnCount(); ++i)
+    ui.m_vdata[i] = model->index(row, i).data();
+
+  beginEdit();
+  selectionModel->clearSelection();
+  if (direction < 0) {
+    model->insertRow(last + 1);
+    model->setRow(last + 1, ui.m_vdata);
+    model->removeRow(row);
+  } else {
+    model->insertRow(first);
+    model->setRow(first, ui.m_vdata);
+    model->removeRow(row + 1);
+  }
+  m_undostack.push(ui);
+
+  table->setCurrentIndex(model->index(first + direction, 0));
+  selectionModel->select(
+    QItemSelection(model->index(first + direction, 0),
+                   model->index(last + direction, 0)),
+    QItemSelectionModel::Select | QItemSelectionModel::Rows);
+  updateSelectionRects();
+  commit();
+}
+
 void ChildWidget::copyFromCell() {
   if (DMESS > 10) qDebug() << Q_FUNC_INFO;
   QClipboard* clipboard = QApplication::clipboard();
@@ -2005,7 +2166,6 @@ void ChildWidget::pasteToCell() {
   if (directTypingMode)
     table->setCurrentIndex(model->index(index.row() + 1, 0));
 
-  updateModelItemBox(index.row());
   updateSelectionRects();
 }
 
@@ -2066,41 +2226,27 @@ void ChildWidget::insertSymbol() {
                   (leftBorder - model->index(index.row(), 1).data().toInt());
 
   int newrow = index.row() + 1;
-  model->insertRow(newrow);
-  model->setData(model->index(newrow, 0), "*");
-  model->setData(model->index(newrow, 1), leftBorder);
-  model->setData(model->index(newrow, 2),
-                 model->index(index.row(), 2).data().toInt());
-  model->setData(model->index(newrow, 3), rightBorder);
-  model->setData(model->index(newrow, 4),
-                 model->index(index.row(), 4).data().toInt());
-  model->setData(model->index(newrow, 5),
-                 model->index(index.row(), 5).data().toInt());
-  model->setData(model->index(newrow, 6),
-                 model->index(index.row(), 6).data().toBool());
-  model->setData(model->index(newrow, 7),
-                 model->index(index.row(), 7).data().toBool());
-  model->setData(model->index(newrow, 8),
-                 model->index(index.row(), 8).data().toBool());
-
   UndoItem ui;
   ui.m_eop = euoAdd;
   ui.m_origrow = newrow;
 
-  // For redo
+  // New box copies the current one, values are kept for redo
   for (int ii = 0; ii < model->columnCount(); ii++)
-    ui.m_vdata[ii] = model->index(ui.m_origrow, ii).data();
+    ui.m_vdata[ii] = model->index(index.row(), ii).data();
+  ui.m_vdata[0] = "*";
+  ui.m_vdata[1] = leftBorder;
+  ui.m_vdata[3] = rightBorder;
 
+  beginEdit();
+  model->insertRow(newrow);
+  model->setRow(newrow, ui.m_vdata);
   m_undostack.push(ui);
 
-  QGraphicsRectItem* rectItem = createModelItemBox(newrow);
-  if (boxesVisible)
-    rectItem->show();
   table->setCurrentIndex(model->index(newrow, 0));
   table->setFocus();
 
   updateSelectionRects();
-  emit modifiedChanged();
+  commit();
 }
 
 void ChildWidget::splitSymbol() {
@@ -2119,46 +2265,35 @@ void ChildWidget::splitSymbol() {
 
   m_undostack.push(ui);
 
-  QModelIndex left = model->index(index.row(), 1);
-  QModelIndex right = model->index(index.row(), 3);
-  int width = right.data().toInt() - left.data().toInt();
+  // Right half is a new box, left half stays in the current row
+  int left = ui.m_vdata[1].toInt();
+  int right = ui.m_vdata[3].toInt();
+  int width = right - left;
+  QVariant rightHalf[BoxTableModel::ColumnCount];
+  for (int i = 0; i < BoxTableModel::ColumnCount; i++)
+    rightHalf[i] = ui.m_vdata[i];
+  rightHalf[0] = "*";
+  rightHalf[1] = right - width / 2;
+
+  beginEdit();
   model->insertRow(index.row() + 1);
-  model->setData(model->index(index.row() + 1, 0), "*");
-  model->setData(model->index(index.row() + 1, 1),
-                 right.data().toInt() - width / 2);
-  model->setData(model->index(index.row() + 1, 2),
-                 model->index(index.row(), 2).data().toInt());
-  model->setData(model->index(index.row() + 1, 3), right.data().toInt());
-  model->setData(model->index(index.row() + 1, 4),
-                 model->index(index.row(), 4).data().toInt());
-  model->setData(model->index(index.row() + 1, 5),
-                 model->index(index.row(), 5).data().toInt());
-  model->setData(model->index(index.row() + 1, 6),
-                 model->index(index.row(), 6).data().toBool());
-  model->setData(model->index(index.row() + 1, 7),
-                 model->index(index.row(), 7).data().toBool());
-  model->setData(model->index(index.row() + 1, 8),
-                 model->index(index.row(), 8).data().toBool());
-  model->setData(right, right.data().toInt() - width / 2);
-
-  updateModelItemBox(index.row());
-  QGraphicsRectItem* rectItem = createModelItemBox(index.row() + 1);
-  if (boxesVisible)
-    rectItem->show();
+  model->setRow(index.row() + 1, rightHalf);
+  model->setData(model->index(index.row(), 3), right - width / 2);
+
   updateSelectionRects();
-  emit modifiedChanged();
+  commit();
 }
 
 void ChildWidget::joinSymbol() {
   if (DMESS > 10) qDebug() << Q_FUNC_INFO;
-  QModelIndexList indexes = selectionModel->selectedRows();
-  if (indexes.empty())
+  QVector<int> rows = selectedRowNumbers();
+  if (rows.empty())
     return;
   // On single selected item join with the next ...
-  if (indexes.size() == 1) {
+  if (rows.size() == 1) {
     // ... if selected is not the last
-    if (indexes.back().row() != model->rowCount() - 1) {
-      indexes.push_back(model->index(indexes.back().row() + 1, 0));
+    if (rows.back() != model->rowCount() - 1) {
+      rows.append(rows.back() + 1);
     } else {
       return;
     }
@@ -2174,107 +2309,153 @@ void ChildWidget::joinSymbol() {
   bool bold = false;
   bool underline = false;
 
-  int targetRow = indexes.front().row();
-
-  QStack<UndoItem> joinstack;
-  UndoItem tempJoin;
-  tempJoin.m_origrow = targetRow;
-  tempJoin.m_eop = euoChange;
-
-  for (int i = 0; i < indexes.size(); ++i) {
-    int row = indexes[i].row();
-    letter += model->data(model->index(row, 0)).toString();
-    left = my_min(left, model->data(model->index(row, 1)).toInt());
-    bottom = my_max(bottom, model->data(model->index(row, 2)).toInt());
-    right = my_max(right, model->data(model->index(row, 3)).toInt());
-    top = my_min(top, model->data(model->index(row, 4)).toInt());
-    page = my_min(page, model->data(model->index(row, 5)).toInt());
-    italic = italic || model->data(model->index(row, 6)).toBool();
-    bold = bold || model->data(model->index(row, 7)).toBool();
-    underline = underline || model->data(model->index(row, 8)).toBool();
-
-    tempJoin.m_vdata[0] = letter;
-    tempJoin.m_vdata[1] = left;
-    tempJoin.m_vdata[2] = bottom;
-    tempJoin.m_vdata[3] = right;
-    tempJoin.m_vdata[4] = top;
-    tempJoin.m_vdata[5] = page;
-    tempJoin.m_vdata[6] = italic;
-    tempJoin.m_vdata[7] = bold;
-    tempJoin.m_vdata[8] = underline;
-
-    joinstack.push_front(tempJoin);
-  }
-
-  model->setData(model->index(targetRow, 0), letter);
-  model->setData(model->index(targetRow, 1), left);
-  model->setData(model->index(targetRow, 2), bottom);
-  model->setData(model->index(targetRow, 3), right);
-  model->setData(model->index(targetRow, 4), top);
-  model->setData(model->index(targetRow, 5), page);
-  model->setData(model->index(targetRow, 6), italic);
-  model->setData(model->index(targetRow, 7), bold);
-  model->setData(model->index(targetRow, 8), underline);
-  updateModelItemBox(targetRow);
-
+  const BoxColumns& boxes = model->boxes();
+  const BoxStore& store = document.store();
+  for (int i = 0; i < rows.size(); ++i) {
+    int row = rows[i];
+    int flags = boxes.flags.at(row);
+    letter += store.glyph(boxes.glyph.at(row));
+    left = my_min(left, boxes.left.at(row));
+    bottom = my_max(bottom, boxes.bottom.at(row));
+    right = my_max(right, boxes.right.at(row));
+    top = my_min(top, boxes.top.at(row));
+    page = my_min(page, boxes.page.at(row));
+    italic = italic || (flags & BoxStore::Italic);
+    bold = bold || (flags & BoxStore::Bold);
+    underline = underline || (flags & BoxStore::Underline);
+  }
+
+  // One undo item: first row keeps joined data, the others are removed
+  int targetRow = rows.front();
+  rows.remove(0);
+  UndoItem ui;
+  ui.m_eop = euoJoinRows;
+  ui.m_origrow = targetRow;
+  for (int i = 0; i < model->columnCount(); i++)
+    ui.m_vdata[i] = model->index(targetRow, i).data();
+  ui.m_vextradata[0] = letter;
+  ui.m_vextradata[1] = left;
+  ui.m_vextradata[2] = bottom;
+  ui.m_vextradata[3] = right;
+  ui.m_vextradata[4] = top;
+  ui.m_vextradata[5] = page;
+  ui.m_vextradata[6] = italic;
+  ui.m_vextradata[7] = bold;
+  ui.m_vextradata[8] = underline;
+  ui.m_rows = rows;
+  for (int i = 0; i < rows.size(); ++i)
+    ui.m_boxes.append(boxes, rows[i]);
+
+  beginEdit();
   selectionModel->clearSelection();
-
-  int rowstodelete = indexes.size();
-  int rownum = indexes.front().row();
-
-  // Keep the first row with joined data
-  rownum++;
-  rowstodelete--;
-
-  for (int i = rowstodelete; i > 0; i--) {
-    m_undostack.push(joinstack.pop());
-    deleteSymbolByRow(rownum);
-  }
+  model->setRow(targetRow, ui.m_vextradata);
+  removeRowRanges(rows);
+  m_undostack.push(ui);
 
   table->setCurrentIndex(model->index(targetRow, 0));
   table->setFocus();
   updateSelectionRects();
-  emit modifiedChanged();
-}
-
-void ChildWidget::deleteSymbolByRow(int row) {
-  if (DMESS > 10) qDebug() << Q_FUNC_INFO;
-  UndoItem ui;
-  ui.m_eop = euoDelete;
-  ui.m_origrow = row;
-  for (int j = 0; j < model->columnCount(); ++j)
-    ui.m_vdata[j] = model->index(ui.m_origrow, j).data();
-  m_undostack.push(ui);
-
-  deleteModelItemBox(ui.m_origrow);
-  model->removeRow(ui.m_origrow);
+  commit();
 }
 
 void ChildWidget::deleteSymbol() {
   if (DMESS > 10) qDebug() << Q_FUNC_INFO;
-  QModelIndexList indexes = selectionModel->selectedRows();
-  if (indexes.empty())
+  QVector<int> rows = selectedRowNumbers();
+  if (rows.empty())
     return;
   // This prevents deselecting dead rows in selectionChanged() on removeRow()
   selectionModel->clearSelection();
 
-  int rowstodelete = indexes.size();
-  int rownum = indexes.front().row();
-  int afterRow = my_min(indexes.back().row() - indexes.size() + 1,
-			model->rowCount() - 1);
-
-  while (!indexes.empty())
-  {
-    deleteSymbolByRow(indexes.back().row());
-    indexes.pop_back();
-  }
+  // All rows are one undo item
+  UndoItem ui;
+  ui.m_eop = euoDeleteRows;
+  ui.m_origrow = rows.front();
+  ui.m_rows = rows;
+  for (int i = 0; i < rows.size(); ++i)
+    ui.m_boxes.append(model->boxes(), rows[i]);
+
+  beginEdit();
+  removeRowRanges(rows);
+  m_undostack.push(ui);
 
+  int afterRow = my_min(rows.back() - rows.size() + 1,
+                        model->rowCount() - 1);
   if (model->rowCount() != 0) {
     table->setCurrentIndex(model->index(afterRow, 0));
   }
   table->setFocus();
   updateSelectionRects();
-  documentWasModified();
+  commit();
+}
+
+/*
+ * Rows are collected from selection ranges once per change of selection
+ * (or of rows) and shared by all handlers, selectedRows() would build an
+ * index for every row and column on every call.
+ */
+const QVector<int>& ChildWidget::selectedRowNumbers() {
+  if (selectionCacheValid)
+    return selectedRowCache;
+
+  selectedRowCache.clear();
+  lastSelectedRowCache = -1;
+  QItemSelection selection = selectionModel->selection();
+  for (int i = 0; i < selection.size(); ++i) {
+    const QItemSelectionRange& range = selection.at(i);
+    if (range.left() != 0)
+      continue;  // rows are selected as a whole
+    for (int row = range.top(); row <= range.bottom(); ++row)
+      selectedRowCache.append(row);
+    lastSelectedRowCache = range.bottom();
+  }
+  qSort(selectedRowCache);
+  // ranges can overlap
+  selectedRowCache.erase(std::unique(selectedRowCache.begin(),
+                                     selectedRowCache.end()),
+                         selectedRowCache.end());
+  selectionCacheValid = true;
+  return selectedRowCache;
+}
+
+int ChildWidget::lastSelectedRow() {
+  selectedRowNumbers();
+  return lastSelectedRowCache;
+}
+
+void ChildWidget::invalidateSelectionCache() {
+  selectionCacheValid = false;
+}
+
+/*
+ * Runs are removed from the last one, so rows of the others do not move.
+ * Every run is one model call (one rowsRemoved() for table, box layer and
+ * journal).
+ */
+void ChildWidget::removeRowRanges(const QVector<int>& rows) {
+  int last = rows.size() - 1;
+  while (last >= 0) {
+    int first = last;
+    while (first > 0 && rows[first - 1] == rows[first] - 1)
+      --first;
+    model->removeRows(rows[first], last - first + 1);
+    last = first - 1;
+  }
+}
+
+/*
+ * Runs are put back from the first one, so every run gets its original
+ * rows again.
+ */
+void ChildWidget::insertRowRanges(const QVector<int>& rows,
+                                  const BoxColumns& boxes) {
+  int first = 0;
+  while (first < rows.size()) {
+    int last = first;
+    while (last + 1 < rows.size() && rows[last + 1] == rows[last] + 1)
+      ++last;
+    model->insertBoxes(rows[first], boxes, first, last - first + 1);
+    first = last + 1;
+  }
 }
 
 void ChildWidget::moveUp() {
@@ -2309,7 +2490,8 @@ void ChildWidget::moveTo() {
   }
 
   moveSymbolRow(destRow - sourceRow);
-  table->resizeRowToContents(destRow);
+  if (!uniformRowHeight)
+    table->resizeRowToContents(destRow);
 }
 
 void ChildWidget::goToRow() {
@@ -2332,6 +2514,160 @@ void ChildWidget::goToRow() {
   }
 }
 
+/*
+ * Check all boxes of document (with unsaved edits) in one pass
+ */
+void ChildWidget::validateBoxes() {
+  if (DMESS > 10) qDebug() << Q_FUNC_INFO;
+  QApplication::setOverrideCursor(Qt::WaitCursor);
+  storePage();
+
+  BoxValidator validator;
+  // Size of other pages of multipage image is not known
+  validator.setImageSize(imageWidth, imageHeight,
+                         pageWidget->isHidden() ? -1 : currPage);
+  validator.validate(&document);
+  document.loadPage(currPage);  // keep shown page the most recent one
+  boxIssues = validator.issues();
+  QApplication::restoreOverrideCursor();
+
+  emit issuesChanged();
+  emit statusBarMessage(tr("%1 issue(s) found").arg(boxIssues.size()));
+}
+
+bool ChildWidget::validateFile(const QString& fileName) {
+  if (DMESS > 10) qDebug() << Q_FUNC_INFO;
+  QFile file(fileName);
+  if (!file.open(QFile::ReadOnly))
+    return false;
+
+  BoxValidator validator;
+  if (pageWidget->isHidden())
+    validator.setImageSize(imageWidth, imageHeight);
+  qint64 size = file.size();
+  uchar* data = 0;
+  if (BoxGzip::isGzipFile(fileName)) {
+    // Inflated data are checked chunk by chunk, as they are parsed
+    BoxGzip gzip(&file);
+    if (!gzip.open(QIODevice::ReadOnly) || !validator.validate(&gzip))
+      return false;
+  } else if (size > 0 && (data = file.map(0, size)) != 0) {
+    validator.validate(reinterpret_cast<const char*>(data), size);
+    file.unmap(data);
+  } else {
+    QByteArray content = file.readAll();
+    validator.validate(content.constData(), content.size());
+  }
+  boxIssues = validator.issues();
+  if (boxIssues.isEmpty())
+    return false;
+
+  QApplication::restoreOverrideCursor();
+  emit issuesChanged();
+  emit statusBarMessage(tr("File can not be loaded, %1 issue(s) found")
+                        .arg(boxIssues.size()));
+  return true;
+}
+
+void ChildWidget::goToBox(int page, int row) {
+  if (DMESS > 10) qDebug() << Q_FUNC_INFO;
+  if (page != currPage) {
+    if (pageWidget->isHidden())
+      return;  // there are no other pages in image
+    currentPage->setValue(page + 1);  // calls slotChangePage()
+    if (page != currPage)
+      return;
+  }
+  if (row < 0 || row >= model->rowCount())
+    return;
+
+  table->setCurrentIndex(model->index(row, 0));
+  table->setFocus();
+  updateSelectionRects();
+}
+
+static void countGlyphs(const BoxColumns& columns, QVector<int>* counts) {
+  for (int row = 0; row < columns.glyph.size(); ++row) {
+    int id = columns.glyph.at(row);
+    if (id >= counts->size())
+      counts->resize(id + 1);
+    ++(*counts)[id];
+  }
+}
+
+// Add (sign 1) or subtract (sign -1) counts to total
+static void addGlyphCounts(const QVector<int>& counts, int sign,
+                           QVector<int>* total) {
+  if (counts.size() > total->size())
+    total->resize(counts.size());
+  for (int id = 0; id < counts.size(); ++id)
+    (*total)[id] += sign * counts.at(id);
+}
+
+/*
+ * Every page is counted once and its counts are kept until the page is
+ * stored from table (or document is read again), so a page flip counts
+ * just the page that was left. The current page is counted from the model
+ * every time, so counts follow editing.
+ */
+QVector<int> ChildWidget::glyphCounts() {
+  if (DMESS > 10) qDebug() << Q_FUNC_INFO;
+  int pages = document.pageCount();
+  pageGlyphCounts.resize(pages);
+  pageGlyphCountsValid.resize(pages);
+  bool counted = false;
+  BoxColumns columns;
+  for (int page = 0; page < pages; ++page) {
+    if (page == currPage || pageGlyphCountsValid.at(page))
+      continue;
+    document.columns(page, &columns);
+    countGlyphs(columns, &pageGlyphCounts[page]);
+    addGlyphCounts(pageGlyphCounts.at(page), 1, &glyphCountTotal);
+    pageGlyphCountsValid[page] = true;
+    counted = true;
+  }
+  if (counted)
+    document.loadPage(currPage);  // keep shown page the most recent one
+
+  QVector<int> counts = glyphCountTotal;
+  if (currPage < pages && pageGlyphCountsValid.at(currPage))
+    addGlyphCounts(pageGlyphCounts.at(currPage), -1, &counts);
+  countGlyphs(model->boxes(), &counts);
+  counts.resize(document.store().glyphCount());
+  return counts;
+}
+
+void ChildWidget::invalidateGlyphCounts(int page) {
+  if (page < 0) {
+    pageGlyphCounts.clear();
+    pageGlyphCountsValid.clear();
+    glyphCountTotal.clear();
+    return;
+  }
+  if (page >= pageGlyphCountsValid.size() || !pageGlyphCountsValid.at(page))
+    return;
+  addGlyphCounts(pageGlyphCounts.at(page), -1, &glyphCountTotal);
+  pageGlyphCounts[page].clear();
+  pageGlyphCountsValid[page] = false;
+}
+
+void ChildWidget::findGlyph(int glyphId) {
+  if (DMESS > 10) qDebug() << Q_FUNC_INFO;
+  const QVector<qint32>& glyph = model->boxes().glyph;
+  int rows = glyph.size();
+  int current = table->currentIndex().row();
+  for (int i = 1; i <= rows; ++i) {
+    int row = (current + i) % rows;
+    if (row < 0)
+      row += rows;
+    if (glyph.at(row) == glyphId) {
+      goToBox(currPage, row);
+      return;
+    }
+  }
+  emit statusBarMessage(tr("Symbol is not on this page."));
+}
+
 void ChildWidget::find() {
   if (DMESS > 10) qDebug() << Q_FUNC_INFO;
   if (!f_dialog) {
@@ -2361,19 +2697,21 @@ QString ChildWidget::getSymbolHexCode() {
   if (DMESS > 10) qDebug() << Q_FUNC_INFO;
   QModelIndex index = selectionModel->currentIndex();
 
-  if (index.isValid()) {
-    QString symbol = model->index(index.row(), 0).data().toString();
-    QString result = "";
-    for (int i = 0; i < symbol.size(); ++i) {
-      QString str2 = QString::number(symbol[i].unicode(),
-                                     16).toUpper().rightJustified(4, '0');
-      result.append("0x" + str2 + " ");
-    }
-    return result;
-  }
+  if (index.isValid())
+    return symbolHexCode(model->index(index.row(), 0).data().toString());
   return QString::null;
 }
 
+QString ChildWidget::symbolHexCode(const QString& symbol) {
+  QString result = "";
+  for (int i = 0; i < symbol.size(); ++i) {
+    QString str2 = QString::number(symbol[i].unicode(),
+                                   16).toUpper().rightJustified(4, '0');
+    result.append("0x" + str2 + " ");
+  }
+  return result;
+}
+
 /* Get size of box */
 QString ChildWidget::getBoxSize() {
   if (DMESS > 10) qDebug() << Q_FUNC_INFO;
@@ -2398,42 +2736,66 @@ QString ChildWidget::currentBoxFile() {
 
 void ChildWidget::documentWasModified() {
   if (DMESS > 10) qDebug() << Q_FUNC_INFO;
+  ++editGeneration;
   modified = true;
   emit modifiedChanged();
 }
 
-void ChildWidget::emitBoxChanged() {
-  if (DMESS > 10) qDebug() << Q_FUNC_INFO;
-  clearBalloons();
-  // updateBalloons();
+/*
+ * Edit outside of transaction (e.g. in table editor) is a transaction of
+ * its own. Its balloons are outdated, action with transaction updates
+ * selection rects itself.
+ */
+void ChildWidget::modelChanged() {
+  if (journalBlocked)
+    return;  // table is being filled
+  if (editDepth == 0)
+    clearBalloons();
+  beginEdit();
+  editPending = true;
+  commit();
+}
+
+void ChildWidget::beginEdit() {
+  ++editDepth;
+}
+
+void ChildWidget::commit() {
+  if (--editDepth > 0)
+    return;
+  if (editPending) {
+    editPending = false;
+    documentWasModified();
+  }
   emit boxChanged();
 }
 
-void ChildWidget::selectionChanged(const QItemSelection& /*selected*/,
+void ChildWidget::selectionChanged(const QItemSelection& selected,
                                    const QItemSelection& deselected) {
   if (DMESS > 10) qDebug() << Q_FUNC_INFO;
-  // Set deselected bboxes' colors back to normal
-  QModelIndexList indexes = deselected.indexes();
-  if (!modelItemBox()) {
-    // hide rectangle of last selected item
-    if (!indexes.empty()) {
-        QGraphicsRectItem* rectItem =
-           model->index(indexes[0].row(), 9).data().value<QGraphicsRectItem*>();
-        rectItem->hide();
-    }
+  selectionCacheValid = false;
+  // Only rows of the change are updated on image
+  selectLayerRows(deselected, false);
+  selectLayerRows(selected, true);
+  if (!selectionModel->hasSelection())
     return;
-  }
-  for (int i = 0; i < indexes.size(); ++i)
-    if (indexes[i].column() == 0) {
-      modelItemBox(indexes[i].row())->setPen(QPen(boxColor));
-      if (!boxesVisible)
-        modelItemBox(indexes[i].row())->hide();
-    }
   updateSelectionRects();
 
   emit boxChanged();
 }
 
+void ChildWidget::selectLayerRows(const QItemSelection& ranges,
+                                  bool selected) {
+  for (int i = 0; i < ranges.size(); ++i) {
+    const QItemSelectionRange& range = ranges.at(i);
+    if (range.left() != 0)
+      continue;
+    int bottom = my_min(range.bottom(), boxLayer->count() - 1);
+    for (int row = range.top(); row <= bottom; ++row)
+      boxLayer->setBoxSelected(row, selected);
+  }
+}
+
 void ChildWidget::clearBalloons() {
   if (DMESS > 10) qDebug() << Q_FUNC_INFO;
   for (int i = 0; i < balloons.size(); ++i) {
@@ -2449,7 +2811,7 @@ void ChildWidget::clearBalloons() {
 
 void ChildWidget::updateBalloons() {
   if (DMESS > 10) qDebug() << Q_FUNC_INFO;
-  int idx = table->selectionModel()->selectedRows().last().row();
+  int idx = lastSelectedRow();
   int min_idx = my_max(idx - balloonCount/2, 0);
   int max_idx = my_min(idx + balloonCount/2, model->rowCount() - 1);
 
@@ -2513,23 +2875,16 @@ void ChildWidget::updateBalloons() {
 
 void ChildWidget::updateSelectionRects() {
   if (DMESS > 10) qDebug() << Q_FUNC_INFO;
-  QModelIndexList indexes = table->selectionModel()->selectedRows();
-  if (!indexes.empty()) {
+  // Box layer follows selection in selectionChanged()
+  const QVector<int>& rows = selectedRowNumbers();
+  if (!rows.empty()) {
     clearBalloons();
-    for (int i = 0; i < indexes.size(); ++i) {
-      QGraphicsRectItem* rectItem = modelItemBox(indexes[i].row());
-      if (rectItem) {
-        rectItem->setPen(QPen(rectColor));
-        rectItem->show();
-      }
-    }
-    if (modelItemBox())
-      imageView->ensureVisible(modelItemBox());
-    if (symbolShown == true && indexes.size() == 1) {
+    imageView->ensureVisible(QRectF(modelItemBox()));
+    if (symbolShown == true && rows.size() == 1) {
       updateBalloons();
-      resizer->setFromRect(modelItemBox()->rect().toRect());
+      resizer->setFromRect(modelItemBox());
     } else {
-      resizer->setFromRect(modelItemBox()->rect().toRect());
+      resizer->setFromRect(modelItemBox());
     }
   } else {
     clearBalloons();
@@ -2542,6 +2897,7 @@ void ChildWidget::closeEvent(QCloseEvent* event) {
   if (!maybeSave()) {
     event->ignore();
   }
+  waitForSave();
   if (fileWatcher)
     delete fileWatcher;
   if (f_dialog)
@@ -2558,9 +2914,10 @@ bool ChildWidget::maybeSave() {
                                  userFriendlyCurrentFile()), QMessageBox::Save
                                | QMessageBox::Discard | QMessageBox::Cancel);
     if (ret == QMessageBox::Save)
-      return save(boxFile);
+      return save(boxFile) && waitForSave();
     else if (ret == QMessageBox::Cancel)
       return false;
+    journal.discard();
   }
   return true;
 }
@@ -2572,7 +2929,9 @@ void ChildWidget::setCurrentImageFile(const QString& fileName) {
 
 void ChildWidget::setCurrentBoxFile(const QString& fileName) {
   if (DMESS > 10) qDebug() << Q_FUNC_INFO;
-  boxFile = QFileInfo(fileName).canonicalFilePath();
+  QFileInfo info(fileName);
+  // File that is not written yet has no canonical path
+  boxFile = info.exists() ? info.canonicalFilePath() : info.absoluteFilePath();
 }
 
 QString ChildWidget::strippedName(const QString& fullFileName) {
@@ -2662,9 +3021,10 @@ void ChildWidget::sbValueChanged(int sbdValue) {
     bIsSpinBoxChanged = true;
   }
 
-  modelItemBox(row)->setRect(QRectF(QPoint(left, top), QPointF(right, bottom)));
+  // Preview, model is changed when editing is finished
+  boxLayer->setBox(row, QRect(left, top, right - left, bottom - top));
 
-  imageView->ensureVisible(modelItemBox(row));
+  imageView->ensureVisible(QRectF(boxLayer->box(row)));
 }
 
 void ChildWidget::sbFinished() {
@@ -2680,19 +3040,38 @@ void ChildWidget::boxDragChanged() {
     return;
 
   int row = index.row();
-  model->setData(model->index(row, 1, QModelIndex()), resizer->rect.left());
-  model->setData(model->index(row, 2, QModelIndex()), resizer->rect.bottom());
-  model->setData(model->index(row, 3, QModelIndex()), resizer->rect.right());
-  model->setData(model->index(row, 4, QModelIndex()), resizer->rect.top());
-  modelItemBox()->setRect(resizer->rect);
+  QVariant values[BoxTableModel::ColumnCount];
+  for (int i = 0; i < BoxTableModel::ColumnCount; i++)
+    values[i] = model->index(row, i).data();
+  values[BoxTableModel::Left] = resizer->rect.left();
+  values[BoxTableModel::Bottom] = resizer->rect.bottom();
+  values[BoxTableModel::Right] = resizer->rect.right();
+  values[BoxTableModel::Top] = resizer->rect.top();
+
+  beginEdit();
+  model->setRow(row, values);
+  commit();
+}
+
+/*
+ * Text of every glyph is compared once, boxes are compared by glyph id.
+ */
+QVector<bool> ChildWidget::matchingGlyphs(const QString& symbol,
+                                          Qt::CaseSensitivity mc) {
+  const BoxStore& store = document.store();
+  QVector<bool> matches(store.glyphCount());
+  for (int id = 0; id < matches.size(); ++id)
+    matches[id] = store.glyph(id).contains(symbol, mc);
+  return matches;
 }
 
 void ChildWidget::findNext(const QString &symbol, Qt::CaseSensitivity mc) {
   if (DMESS > 10) qDebug() << Q_FUNC_INFO;
+  QVector<bool> matches = matchingGlyphs(symbol, mc);
+  const QVector<qint32>& glyph = model->boxes().glyph;
   int row = table->currentIndex().row() + 1;
   while (row < model->rowCount()) {
-    QString letter = model->index(row, 0).data().toString();
-    if (letter.contains(symbol, mc)) {
+    if (matches.at(glyph.at(row))) {
       table->setCurrentIndex(model->index(row, 0));
       table->setFocus();
       updateSelectionRects();
@@ -2707,10 +3086,11 @@ void ChildWidget::findNext(const QString &symbol, Qt::CaseSensitivity mc) {
 void ChildWidget::findPrev(const QString &symbol,
                            Qt::CaseSensitivity mc) {
   if (DMESS > 10) qDebug() << Q_FUNC_INFO;
+  QVector<bool> matches = matchingGlyphs(symbol, mc);
+  const QVector<qint32>& glyph = model->boxes().glyph;
   int row = table->currentIndex().row() - 1;
   while (row >= 0) {
-    QString letter = model->index(row, 0).data().toString();
-    if (letter.contains(symbol, mc)) {
+    if (matches.at(glyph.at(row))) {
       table->setCurrentIndex(model->index(row, 0));
       table->setFocus();
       updateSelectionRects();
@@ -2732,6 +3112,148 @@ bool ChildWidget::isRedoAvailable() {
   return m_redostack.isEmpty() ? false : true;
 }
 
+// Parts present in packed undo item
+enum UndoItemParts {
+  HasData = 1,
+  HasExtraData = 2,
+  HasRows = 4
+};
+
+// Box of undo item: glyph id, coordinates, page and font flags
+static void packBox(QDataStream* out, const QVariant* values,
+                    BoxStore* store) {
+  int flags = 0;
+  if (values[BoxTableModel::Italic].toBool())
+    flags |= BoxStore::Italic;
+  if (values[BoxTableModel::Bold].toBool())
+    flags |= BoxStore::Bold;
+  if (values[BoxTableModel::Underline].toBool())
+    flags |= BoxStore::Underline;
+  *out << static_cast<qint32>(store->intern(values[0].toString()));
+  for (int i = BoxTableModel::Left; i <= BoxTableModel::Page; ++i)
+    *out << static_cast<qint32>(values[i].toInt());
+  *out << static_cast<quint8>(flags);
+}
+
+static void unpackBox(QDataStream* in, QVariant* values,
+                      const BoxStore& store) {
+  qint32 number;
+  quint8 flags;
+  *in >> number;
+  values[0] = store.glyph(number);
+  for (int i = BoxTableModel::Left; i <= BoxTableModel::Page; ++i) {
+    *in >> number;
+    values[i] = static_cast<int>(number);
+  }
+  *in >> flags;
+  values[BoxTableModel::Italic] = (flags & BoxStore::Italic) != 0;
+  values[BoxTableModel::Bold] = (flags & BoxStore::Bold) != 0;
+  values[BoxTableModel::Underline] = (flags & BoxStore::Underline) != 0;
+}
+
+/*
+ * Undo item is packed to about 40 bytes instead of 18 QVariants. The
+ * second row (m_vextradata) is stored as a diff to the first one: a mask
+ * of changed columns, then new values of changed columns (flags just
+ * toggle). Removed rows (m_rows/m_boxes) are stored column by column.
+ */
+static QByteArray packUndoItem(const UndoItem& ui, BoxStore* store) {
+  quint8 parts = 0;
+  if (ui.m_vdata[0].isValid())
+    parts |= HasData;
+  if (ui.m_vextradata[0].isValid())
+    parts |= HasExtraData;
+  if (!ui.m_rows.isEmpty())
+    parts |= HasRows;
+
+  QByteArray record;
+  QDataStream out(&record, QIODevice::WriteOnly);
+  out.setVersion(QDataStream::Qt_4_6);
+  out << static_cast<quint16>(ui.m_eop) << static_cast<qint32>(ui.m_origrow)
+      << static_cast<qint32>(ui.m_extrarow) << parts;
+  if (parts & HasData)
+    packBox(&out, ui.m_vdata, store);
+  if ((parts & HasExtraData) && !(parts & HasData)) {
+    packBox(&out, ui.m_vextradata, store);
+  } else if (parts & HasExtraData) {
+    quint16 changed = 0;
+    for (int i = 0; i < BoxTableModel::ColumnCount; ++i)
+      if (ui.m_vextradata[i] != ui.m_vdata[i])
+        changed |= 1 << i;
+    out << changed;
+    if (changed & 1)
+      out << static_cast<qint32>(
+               store->intern(ui.m_vextradata[0].toString()));
+    for (int i = BoxTableModel::Left; i <= BoxTableModel::Page; ++i)
+      if (changed & (1 << i))
+        out << static_cast<qint32>(ui.m_vextradata[i].toInt());
+  }
+  if (parts & HasRows) {
+    out << ui.m_rows << ui.m_boxes.glyph << ui.m_boxes.left
+        << ui.m_boxes.bottom << ui.m_boxes.right << ui.m_boxes.top
+        << ui.m_boxes.page << ui.m_boxes.flags;
+  }
+  return record;
+}
+
+static UndoItem unpackUndoItem(const QByteArray& record,
+                               const BoxStore& store) {
+  QDataStream in(record);
+  in.setVersion(QDataStream::Qt_4_6);
+  quint16 op;
+  qint32 origrow, extrarow;
+  quint8 parts;
+  in >> op >> origrow >> extrarow >> parts;
+
+  UndoItem ui;
+  ui.m_eop = static_cast<undoOperation>(op);
+  ui.m_origrow = origrow;
+  ui.m_extrarow = extrarow;
+  if (parts & HasData)
+    unpackBox(&in, ui.m_vdata, store);
+  if ((parts & HasExtraData) && !(parts & HasData)) {
+    unpackBox(&in, ui.m_vextradata, store);
+  } else if (parts & HasExtraData) {
+    quint16 changed;
+    qint32 number;
+    in >> changed;
+    for (int i = 0; i < BoxTableModel::ColumnCount; ++i)
+      ui.m_vextradata[i] = ui.m_vdata[i];
+    if (changed & 1) {
+      in >> number;
+      ui.m_vextradata[0] = store.glyph(number);
+    }
+    for (int i = BoxTableModel::Left; i <= BoxTableModel::Page; ++i) {
+      if (changed & (1 << i)) {
+        in >> number;
+        ui.m_vextradata[i] = static_cast<int>(number);
+      }
+    }
+    for (int i = BoxTableModel::Italic; i <= BoxTableModel::Underline; ++i)
+      if (changed & (1 << i))
+        ui.m_vextradata[i] = !ui.m_vdata[i].toBool();
+  }
+  if (parts & HasRows) {
+    in >> ui.m_rows >> ui.m_boxes.glyph >> ui.m_boxes.left
+       >> ui.m_boxes.bottom >> ui.m_boxes.right >> ui.m_boxes.top
+       >> ui.m_boxes.page >> ui.m_boxes.flags;
+  }
+  return ui;
+}
+
+void ChildWidget::UndoStack::push(const UndoItem& t, bool bClearRedo) {
+  // When a new undo item is push we need
+  // To clear the redo stack.
+  if (m_pRedoStack && bClearRedo) {
+    m_pRedoStack->clear();
+  }
+  m_log.push(packUndoItem(t, m_store));
+}
+
+UndoItem ChildWidget::UndoStack::pop() {
+  return unpackUndoItem(m_log.pop(), *m_store);
+}
+
 void ChildWidget::undo() {
   if (DMESS > 10) qDebug() << Q_FUNC_INFO;
   if (m_undostack.isEmpty()) {
@@ -2743,6 +3265,7 @@ void ChildWidget::undo() {
   }
 
   UndoItem ui = m_undostack.pop();
+  beginEdit();
 
   switch (ui.m_eop) {
   case euoAdd:
@@ -2773,6 +3296,18 @@ void ChildWidget::undo() {
     // Two item changed places. Change places back.
     undoMoveBack2(ui);
     break;
+  case euoDeleteRows:
+    // Rows were deleted. Put them back.
+    undoDeleteRows(ui);
+    break;
+  case euoJoinRows:
+    // Rows were joined to the first one. Put them back.
+    undoJoinRows(ui);
+    break;
+  case euoChangeRows:
+    // Rows were edited. Put back old boxes.
+    undoChangeRows(ui);
+    break;
   default:
     // Nothing to do for other cases. Report error.
 
@@ -2783,14 +3318,13 @@ void ChildWidget::undo() {
     break;
   }
 
-  emit boxChanged();  // update toolbar/menu
+  commit();  // update toolbar/menu
 }
 
 // Delete item as undo operation of add
 void ChildWidget::undoDelete(UndoItem& ui, bool bIsRedo) {
   if (DMESS > 10) qDebug() << Q_FUNC_INFO;
   selectionModel->clearSelection();
-  deleteModelItemBox(ui.m_origrow);
   model->removeRow(ui.m_origrow);
 
   int rows = model->rowCount();
@@ -2810,6 +3344,69 @@ void ChildWidget::undoDelete(UndoItem& ui, bool bIsRedo) {
     m_redostack.push(ui);
 }
 
+// Put back deleted rows (or delete them again on redo)
+void ChildWidget::undoDeleteRows(UndoItem& ui, bool bIsRedo) {
+  if (DMESS > 10) qDebug() << Q_FUNC_INFO;
+  selectionModel->clearSelection();
+  if (bIsRedo)
+    removeRowRanges(ui.m_rows);
+  else
+    insertRowRanges(ui.m_rows, ui.m_boxes);
+
+  int row = my_min(ui.m_origrow, model->rowCount() - 1);
+  table->setCurrentIndex(model->index(row, 0));
+  table->setFocus();
+  updateSelectionRects();
+
+  if (bIsRedo)
+    m_undostack.push(ui, false);
+  else
+    m_redostack.push(ui);
+}
+
+// Split joined row back to its rows (or join them again on redo)
+void ChildWidget::undoJoinRows(UndoItem& ui, bool bIsRedo) {
+  if (DMESS > 10) qDebug() << Q_FUNC_INFO;
+  selectionModel->clearSelection();
+  if (bIsRedo) {
+    model->setRow(ui.m_origrow, ui.m_vextradata);
+    removeRowRanges(ui.m_rows);
+  } else {
+    insertRowRanges(ui.m_rows, ui.m_boxes);
+    model->setRow(ui.m_origrow, ui.m_vdata);
+  }
+
+  table->setCurrentIndex(model->index(ui.m_origrow, 0));
+  table->setFocus();
+  updateSelectionRects();
+
+  if (bIsRedo)
+    m_undostack.push(ui, false);
+  else
+    m_redostack.push(ui);
+}
+
+// Swap boxes of changed rows with the stored ones, so the item keeps the
+// boxes for the opposite operation
+void ChildWidget::undoChangeRows(UndoItem& ui, bool bIsRedo) {
+  if (DMESS > 10) qDebug() << Q_FUNC_INFO;
+  BoxColumns current;
+  for (int i = 0; i < ui.m_rows.size(); ++i) {
+    current.append(model->boxes(), ui.m_rows[i]);
+    model->setRow(ui.m_rows[i], ui.m_boxes, i);
+  }
+  ui.m_boxes = current;
+
+  table->setCurrentIndex(model->index(ui.m_origrow, 0));
+  table->setFocus();
+  updateSelectionRects();
+
+  if (bIsRedo)
+    m_undostack.push(ui, false);
+  else
+    m_redostack.push(ui);
+}
+
 // Add back item as undo operation of delete
 void ChildWidget::undoAdd(UndoItem& ui, bool bIsRedo) {
   if (DMESS > 10) qDebug() << Q_FUNC_INFO;
@@ -2822,26 +3419,18 @@ void ChildWidget::undoEdit(UndoItem& ui, bool bIsRedo) {
   if (DMESS > 10) qDebug() << Q_FUNC_INFO;
   if (ui.m_eop == euoChange) {
     if (bIsRedo) {
-      for (int i = 0; i < model->columnCount() - 1; i++)
-        model->setData(model->index(ui.m_origrow, i), ui.m_vextradata[i]);
+      model->setRow(ui.m_origrow, ui.m_vextradata);
     } else {
       // Save for redo
-      for (int ii = 0; ii < model->columnCount() - 1; ii++)
+      for (int ii = 0; ii < model->columnCount(); ii++)
         ui.m_vextradata[ii] = model->index(ui.m_origrow, ii).data();
 
-      for (int i = 0; i < model->columnCount() -1 ; i++)
-        model->setData(model->index(ui.m_origrow, i), ui.m_vdata[i]);
+      model->setRow(ui.m_origrow, ui.m_vdata);
     }
   } else {
-    for (int i = 0; i < model->columnCount() - 1; i++)
-      model->setData(model->index(ui.m_origrow, i), ui.m_vdata[i]);
+    model->setRow(ui.m_origrow, ui.m_vdata);
   }
 
-  if (ui.m_eop == euoDelete || (bIsRedo && ui.m_eop == euoAdd))
-    createModelItemBox(ui.m_origrow);
-  else
-    updateModelItemBox(ui.m_origrow);
-
   table->setCurrentIndex(model->index(ui.m_origrow, 0));
   table->setFocus();
   updateSelectionRects();
@@ -2866,12 +3455,8 @@ void ChildWidget::undoJoin(UndoItem& ui, bool bIsRedo) {
     rui.m_vextradata[i] = model->index(rui.m_extrarow, i).data();
   }
 
-  deleteModelItemBox(ui.m_extrarow);
   model->removeRow(ui.m_extrarow);
-
-  for (int i = 0; i < model->columnCount(); i++)
-    model->setData(model->index(ui.m_origrow, i), ui.m_vdata[i]);
-  updateModelItemBox(ui.m_origrow);
+  model->setRow(ui.m_origrow, ui.m_vdata);
 
   table->setCurrentIndex(model->index(ui.m_origrow, 0));
   table->setFocus();
@@ -2897,12 +3482,8 @@ void ChildWidget::undoSplit(UndoItem& ui, bool bIsRedo) {
   }
 
   model->insertRow(ui.m_extrarow);
-  for (int i = 0; i < model->columnCount(); i++) {
-    model->setData(model->index(ui.m_extrarow, i), ui.m_vextradata[i]);
-    model->setData(model->index(ui.m_origrow, i), ui.m_vdata[i]);
-  }
-  updateModelItemBox(ui.m_origrow);
-  createModelItemBox(ui.m_extrarow);
+  model->setRow(ui.m_extrarow, ui.m_vextradata);
+  model->setRow(ui.m_origrow, ui.m_vdata);
 
   table->setCurrentIndex(model->index(ui.m_origrow, 0));
   table->setFocus();
@@ -2925,12 +3506,8 @@ void ChildWidget::undoMoveBack(UndoItem& ui, bool bIsRedo) {
     secondrow = ui.m_origrow;
   }
 
-  for (int i = 0; i < model->columnCount() - 1; i++) {
-    model->setData(model->index(firstrow, i), ui.m_vdata[i]);
-    model->setData(model->index(secondrow, i), ui.m_vextradata[i]);
-  }
-  updateModelItemBox(ui.m_origrow);
-  updateModelItemBox(ui.m_extrarow);
+  model->setRow(firstrow, ui.m_vdata);
+  model->setRow(secondrow, ui.m_vextradata);
 
   table->setCurrentIndex(model->index(firstrow, 0));
   table->setFocus();
@@ -2960,11 +3537,7 @@ void ChildWidget::undoMoveBack2(UndoItem& ui, bool bIsRedo) {
       firstrow++;
 
   model->insertRow(firstrow);
-
-  for (int i = 0; i < model->columnCount() - 1; i++) {
-    model->setData(model->index(firstrow, i), ui.m_vdata[i]);
-  }
-  createModelItemBox(firstrow);
+  model->setRow(firstrow, ui.m_vdata);
 
   model->removeRow(secondrow);
 
@@ -2991,6 +3564,7 @@ void ChildWidget::redo() {
   }
 
   UndoItem ui = m_redostack.pop();
+  beginEdit();
 
   switch (ui.m_eop) {
   case euoAdd:
@@ -3021,6 +3595,18 @@ void ChildWidget::redo() {
     // Two item changed places. Change places back.
     undoMoveBack2(ui, true);
     break;
+  case euoDeleteRows:
+    // Rows were deleted. Redo: delete them again
+    undoDeleteRows(ui, true);
+    break;
+  case euoJoinRows:
+    // Rows were joined. Redo: join them again
+    undoJoinRows(ui, true);
+    break;
+  case euoChangeRows:
+    // Rows were edited. Redo: put back new boxes
+    undoChangeRows(ui, true);
+    break;
   default:
     // Nothing to do for other cases. Report error.
 
@@ -3031,32 +3617,47 @@ void ChildWidget::redo() {
     break;
   }
 
-  emit boxChanged();
+  commit();
 }
 
+/*
+ * Page visited recently is only swapped back from pageCache, other pages
+ * are read from image file and document.
+ */
 bool ChildWidget::slotChangePage(int sbdPage) {
   if (DMESS > 10) qDebug() << Q_FUNC_INFO;
-  PIX * pix;
+  int page = sbdPage - 1;
+  PageView* view = pageCache.take(page);
   QImage image;
+  if (!view) {
+    PIX * pix;
+    pix = pixReadTiff(imageFile.toLocal8Bit().data(), page);
+    image = TessTools::PIX2qImage(pix);
+    pixDestroy(&pix);
+    if (image.isNull()) {
+      QMessageBox::information(this, tr("Problem"),
+                               tr("Cannot load page %1 from file %2.")
+                               .arg(sbdPage).arg(imageFile));
+      return false;
+    }
+  }
+
   storePage();
-  currPage = sbdPage - 1;
+  bool showFontColumns = isFontColumnsShown();
+  cachePage();
+  currPage = page;
 
-  pix = pixReadTiff(imageFile.toLocal8Bit().data(), currPage);
-  image = TessTools::PIX2qImage(pix);
-  pixDestroy(&pix);
-  if (image.isNull()) {
-    QMessageBox::information(this, tr("Problem"),
-                             tr("Cannot load page %1 from file %1.")
-                             .arg(currPage).arg(imageFile));
-    return false;
+  if (view) {
+    showCachedPage(view);
+    setShowFontColumns(showFontColumns);
+    updateSelectionRects();
+    return true;
   }
+
   imageHeight = image.height();
   imageWidth = image.width();
-  imageScene->removeItem(imageItem);
   imageItem = imageScene->addPixmap(QPixmap::fromImage(image));
-
-  bool showFontColumns = isFontColumnsShown();
-  cleanTable();
+  newBoxLayer();
   initTable();
   setShowFontColumns(showFontColumns);
   if (fillTableData(currPage)) {
@@ -3068,8 +3669,74 @@ bool ChildWidget::slotChangePage(int sbdPage) {
   return true;
 }
 
+PageView::~PageView() {
+  delete selectionModel;
+  delete model;
+  delete boxLayer;
+  delete imageItem;
+}
+
 /*
- * Store current page (in table view) to pages vector
+ * Items of page are only taken out of scene. Selection stays in model and
+ * layer, balloons and resizer are shown again by updateSelectionRects().
+ */
+void ChildWidget::cachePage() {
+  if (DMESS > 10) qDebug() << Q_FUNC_INFO;
+  clearBalloons();
+  resizer->disable();
+  imageScene->removeItem(boxLayer);
+  imageScene->removeItem(imageItem);
+
+  PageView* view = new PageView;
+  view->model = model;
+  view->selectionModel = selectionModel;
+  view->boxLayer = boxLayer;
+  view->imageItem = imageItem;
+  view->imageWidth = imageWidth;
+  view->imageHeight = imageHeight;
+  model = 0;
+  selectionModel = 0;
+  boxLayer = 0;
+  imageItem = 0;
+
+  // image is 32-bit pixmap, about 64 bytes per row in model and layer
+  qint64 bytes = static_cast<qint64>(imageWidth) * imageHeight * 4 +
+                 view->model->rowCount() * 64;
+  int cost = static_cast<int>(qMin(bytes / 1024 + 1, qint64(INT_MAX)));
+  // page is deleted right away if it does not fit to cache at all
+  pageCache.insert(currPage, view, cost);
+}
+
+void ChildWidget::showCachedPage(PageView* view) {
+  if (DMESS > 10) qDebug() << Q_FUNC_INFO;
+  model = view->model;
+  selectionModel = view->selectionModel;
+  boxLayer = view->boxLayer;
+  imageItem = view->imageItem;
+  imageWidth = view->imageWidth;
+  imageHeight = view->imageHeight;
+  view->model = 0;
+  view->selectionModel = 0;
+  view->boxLayer = 0;
+  view->imageItem = 0;
+  delete view;
+
+  imageScene->addItem(imageItem);
+  boxLayer->setBoxesVisible(boxesVisible);
+  imageScene->addItem(boxLayer);
+  attachModel();
+}
+
+void ChildWidget::newBoxLayer() {
+  if (DMESS > 10) qDebug() << Q_FUNC_INFO;
+  boxLayer = new BoxLayer;
+  boxLayer->setColors(boxColor, rectColor, rectFillColor);
+  boxLayer->setBoxesVisible(boxesVisible);
+  imageScene->addItem(boxLayer);
+}
+
+/*
+ * Store current page (in table view) to document
  *
  */
 void ChildWidget::storePage() {
@@ -3077,45 +3744,122 @@ void ChildWidget::storePage() {
   if (!index.isValid())
     return;
 
-  QVector<QStringList> page;
-  for (int row = 0; row < model->rowCount(); ++row) {
-    QString letter = model->index(row, 0).data().toString();
-    QString left = model->index(row, 1).data().toString();
-    int bottom = model->index(row, 2).data().toInt();
-    QString right = model->index(row, 3).data().toString();
-    int top = model->index(row, 4).data().toInt();
-    QString pageNum = model->index(row, 5).data().toString();
-    bool italic = model->index(row, 6).data().toBool();
-    bool bold = model->index(row, 7).data().toBool();
-    bool underline = model->index(row, 8).data().toBool();
-    if (underline)
-      letter.prepend("\'");
-    if (italic)
-      letter.prepend("$");
-    if (bold)
-      letter.prepend("@");
-    QStringList box;
-    box << letter << left << QString::number(imageHeight - bottom)
-        << right  << QString::number(imageHeight - top) << pageNum;
-    page.append(box);
-  }
-  pages[currPage] = page;
+  // document keeps box file coordinates
+  BoxColumns columns = model->boxes();
+  columns.flipVertical(imageHeight);
+  document.setPage(currPage, columns);
+  invalidateGlyphCounts(currPage);
+}
+
+QByteArray ChildWidget::formatRow(int row) {
+  QString letter = model->index(row, 0).data().toString();
+  int left = model->index(row, 1).data().toInt();
+  int bottom = model->index(row, 2).data().toInt();
+  int right = model->index(row, 3).data().toInt();
+  int top = model->index(row, 4).data().toInt();
+  int pageNum = model->index(row, 5).data().toInt();
+  bool italic = model->index(row, 6).data().toBool();
+  bool bold = model->index(row, 7).data().toBool();
+  bool underline = model->index(row, 8).data().toBool();
+  // Model is in image coordinates, journal in box file coordinates.
+  // Line-level file keeps tab rows (end of line) as plain boxes, text of
+  // WordStr line has no font prefixes
+  if (document.isWordStr() && letter != "\t")
+    return BoxSerializer::formatWordStr(letter, left, imageHeight - bottom,
+                                        right, imageHeight - top, pageNum);
+  if (underline)
+    letter.prepend("\'");
+  if (italic)
+    letter.prepend("$");
+  if (bold)
+    letter.prepend("@");
+  return BoxSerializer::formatRow(letter, left, imageHeight - bottom,
+                                  right, imageHeight - top, pageNum);
+}
+
+/*
+ * Journal rows of current page. Rows created by insertRow() are filled by
+ * setData() afterwards, which is journaled by journalDataChanged().
+ */
+void ChildWidget::journalRowsInserted(const QModelIndex& parent, int first,
+                                      int last) {
+  if (journalBlocked || parent.isValid())
+    return;
+  for (int row = first; row <= last; ++row)
+    journal.append(BoxJournal::InsertRow, currPage, row, formatRow(row));
+}
+
+void ChildWidget::journalRowsRemoved(const QModelIndex& parent, int first,
+                                     int last) {
+  if (journalBlocked || parent.isValid())
+    return;
+  for (int row = first; row <= last; ++row)
+    journal.append(BoxJournal::RemoveRow, currPage, first);
+}
+
+void ChildWidget::journalDataChanged(const QModelIndex& topLeft,
+                                     const QModelIndex& bottomRight) {
+  if (journalBlocked || topLeft.column() > BoxTableModel::Underline)
+    return;
+  for (int row = topLeft.row(); row <= bottomRight.row(); ++row)
+    journal.append(BoxJournal::SetRow, currPage, row, formatRow(row));
+}
+
+void ChildWidget::recoverJournal(const QString& fileName) {
+  if (DMESS > 10) qDebug() << Q_FUNC_INFO;
+  QSettings settings(QSettings::IniFormat, QSettings::UserScope,
+                     SETTING_ORGANIZATION, SETTING_APPLICATION);
+  if (!settings.value("Boxes/Journal", true).toBool()) {
+    journal.discard();
+    return;
+  }
+
+  QVector<BoxJournal::Record> records;
+  if (!journal.open(fileName, &records) || records.isEmpty())
+    return;
+
+  QMessageBox::StandardButton ret;
+  ret = QMessageBox::question(this, SETTING_APPLICATION,
+                              tr("'%1' has %2 unsaved change(s) from previous "
+                                 "session.\nDo you want to recover them?")
+                              .arg(QFileInfo(fileName).fileName())
+                              .arg(records.size()),
+                              QMessageBox::Yes | QMessageBox::No);
+  if (ret != QMessageBox::Yes) {
+    journal.discard();
+    return;
+  }
+
+  for (int i = 0; i < records.size(); ++i) {
+    const BoxJournal::Record& record = records.at(i);
+    bool ok = false;
+    switch (record.op) {
+      case BoxJournal::SetRow:
+        ok = document.setRow(record.page, record.row, record.line);
+        break;
+      case BoxJournal::InsertRow:
+        ok = document.insertRow(record.page, record.row, record.line);
+        break;
+      case BoxJournal::RemoveRow:
+        ok = document.removeRow(record.page, record.row);
+        break;
+    }
+    if (!ok) {
+      QMessageBox::warning(this, SETTING_APPLICATION,
+                           tr("Only %1 of %2 changes could be recovered.")
+                           .arg(i).arg(records.size()));
+      break;
+    }
+  }
 }
 
 void ChildWidget::cleanTable() {
   // Hide current selection - it is not valid on other page
-  QModelIndexList indexes = table->selectionModel()->selectedRows();
-  if (!indexes.empty()) {
+  if (selectionModel->hasSelection())
     clearBalloons();
-    for (int i = 0; i < indexes.size(); ++i) {
-      QGraphicsRectItem* rectItem = modelItemBox(indexes[i].row());
-      if (rectItem) {
-        rectItem->hide();
-      }
-    }
-  }
 
   selectionModel->clearSelection();
+  // Boxes of page are dropped from box layer too (see layerReset())
   model->clear();
   delete selectionModel;
   delete model;
@@ -26,15 +26,18 @@
 #ifndef SRC_CHILDWIDGET_H_
 #define SRC_CHILDWIDGET_H_
 
+#include <QBuffer>
+#include <QCache>
 #include <QDebug>
 #include <QDir>
 #include <QFileInfo>
+#include <QDataStream>
 #include <QFileSystemWatcher>
+#include <QFontMetrics>
 #include <QSettings>
 #include <QTextStream>
 #include <qmath.h>
 #include <QScrollBar>
-#include <QStack>
 #include <QAbstractItemView>
 #include <QApplication>
 #include <QClipboard>
@@ -51,15 +54,23 @@
 #include <QRubberBand>
 #include <QSpinBox>
 #include <QSplitter>
-#include <QStandardItemModel>
 #include <QTableView>
 #include <QTableWidgetItem>
+#include <QThread>
+#include <QThreadPool>
 #include <QTransform>
 
 #if QT_VERSION >= QT_VERSION_CHECK(5, 0, 0)
 #include <QGuiApplication>
 #endif
 
+#include "BoxDocument.h"
+#include "BoxJournal.h"
+#include "BoxLayer.h"
+#include "BoxTableModel.h"
+#include "BoxUndoLog.h"
+#include "BoxValidator.h"
+
 class QGraphicsScene;
 class QGraphicsView;
 class QAbstractItemModel;
@@ -69,6 +80,7 @@ class QGraphicsItem;
 class QGraphicsRectItem;
 class FindDialog;
 class DrawRectangle;
+class BoxSaveJob;
 
 enum undoOperation {
     euoAdd = 1,
@@ -77,7 +89,10 @@ enum undoOperation {
     euoJoin = 8,
     euoSplit = 16,
     euoReplace = 32,
-    euoMove = 64
+    euoMove = 64,
+    euoDeleteRows = 128,
+    euoJoinRows = 256,
+    euoChangeRows = 512
 };
 
 struct UndoItem {
@@ -86,6 +101,10 @@ struct UndoItem {
     int m_extrarow;
     QVariant m_vdata[9];
     QVariant m_vextradata[9];
+    // Removed rows of euoDeleteRows/euoJoinRows (ascending) and their boxes,
+    // changed rows of euoChangeRows and their other (old or new) boxes
+    QVector<int> m_rows;
+    BoxColumns m_boxes;
 };
 
 // Overhead symbol displayed in Show symbol mode
@@ -100,6 +119,21 @@ struct BalloonSymbol {
     QGraphicsTextItem* halo[haloCompCount];
 };
 
+// Page that is not shown, but is kept ready to show (see pageCache)
+struct PageView {
+    PageView()
+      : model(0), selectionModel(0), boxLayer(0), imageItem(0),
+        imageWidth(0), imageHeight(0) {}
+    ~PageView();
+
+    BoxTableModel* model;
+    QItemSelectionModel* selectionModel;
+    BoxLayer* boxLayer;
+    QGraphicsItem* imageItem;
+    int imageWidth;
+    int imageHeight;
+};
+
 // Eight geometric directions
 enum Dir8m { dirNone = -1, dirE = 0, dirNE, dirN, dirNW, dirW, dirSW, dirS,
              dirSE, dirCount };
@@ -152,6 +186,13 @@ class ChildWidget : public QSplitter {
     bool isBoxSelected();
     bool isUndoAvailable();
     bool isRedoAvailable();
+    /**
+     * Start edit transaction. Model changes until the matching commit()
+     * are reported by one modifiedChanged()/boxChanged() pair. Nested
+     * transactions are joined to the outer one.
+     */
+    void beginEdit();
+    void commit();
     bool isBold();
     bool isItalic();
     bool isUnderLine();
@@ -163,15 +204,37 @@ class ChildWidget : public QSplitter {
 
     QString userFriendlyCurrentFile();
     QString getSymbolHexCode();
+    /** Codes of all characters of symbol, e.g. "0x0041 0x030A ". */
+    static QString symbolHexCode(const QString& symbol);
     QString getBoxSize();
     QString currentBoxFile();
+    /** Box file of image: <base>.box, or <base>.box.gz if only it exists. */
+    static QString boxFileName(const QString& imageFile);
     QString canonicalImageFileName() {
         return imageFile;
     }
 
+    /** Problems found by the last validation (see validateBoxes()). */
+    const QVector<BoxIssue>& issues() const {
+        return boxIssues;
+    }
+    /** Show page and select row of box (e.g. of issue). */
+    void goToBox(int page, int row);
+    /** Interned glyphs of document (ids are indexes of glyphCounts()). */
+    const BoxStore& glyphs() const {
+        return document.store();
+    }
+    /** Number of boxes of every glyph id in all pages (unicharset). */
+    QVector<int> glyphCounts();
+    /** Select next box of glyph on current page (wraps around). */
+    void findGlyph(int glyphId);
+
     bool reload(const QString& fileName);
     bool reloadImg();
+    /** Start saving in background, see waitForSave(). */
     bool save(const QString& fileName);
+    /** Block until running save is finished, return its result. */
+    bool waitForSave();
     bool splitToFeatureBF(const QString& fileName);
     bool saveString(const QString& fileName, const QString& qData);
     bool createStringImage(const QString& fileName, const QString& qData);
@@ -225,6 +288,7 @@ class ChildWidget : public QSplitter {
     void moveTo();
     void goToRow();
     void find();
+    void validateBoxes();
     void findNext(const QString &symbol, Qt::CaseSensitivity mc);
     void findPrev(const QString &symbol, Qt::CaseSensitivity mc);
 
@@ -232,8 +296,30 @@ class ChildWidget : public QSplitter {
 
   private:
     void initTable();
-    void deleteSymbolByRow(int row);
+    void initDelegates();
+    /** Show model/selectionModel in table (after it was swapped). */
+    void attachModel();
+    /** Selected rows, ascending (cached until selection/rows change). */
+    const QVector<int>& selectedRowNumbers();
+    /** Last row of selection (as selectedRows().last()) or -1. */
+    int lastSelectedRow();
+    QVector<int> selectedRowCache;        /**< see selectedRowNumbers() */
+    int lastSelectedRowCache;             /**< see lastSelectedRow() */
+    bool selectionCacheValid;
+    /** Show rows of selection change on box layer. */
+    void selectLayerRows(const QItemSelection& ranges, bool selected);
+    /** Remove sorted rows, every run of consecutive rows at once. */
+    void removeRowRanges(const QVector<int>& rows);
+    /** Put back rows removed by removeRowRanges(). */
+    void insertRowRanges(const QVector<int>& rows, const BoxColumns& boxes);
+    /** Move rows first..last by one row up (-1) or down (1). */
+    void moveRowBlock(int first, int last, int direction);
+    /** Set flag column of selected rows as one undo item. */
+    void setSelectedFlag(int column, bool on);
     void undoDelete(UndoItem& ui, bool bIsRedo = false);
+    void undoDeleteRows(UndoItem& ui, bool bIsRedo = false);
+    void undoJoinRows(UndoItem& ui, bool bIsRedo = false);
+    void undoChangeRows(UndoItem& ui, bool bIsRedo = false);
     void undoAdd(UndoItem& ui, bool bIsRedo = false);
     void undoEdit(UndoItem& ui, bool bIsRedo = false);
     void undoJoin(UndoItem& ui, bool bIsRedo = false);
@@ -263,19 +349,46 @@ class ChildWidget : public QSplitter {
     void moveSymbolRow(int direction);
     QList<QTableWidgetItem*> takeRow(int row);
     void calculateTableWidth();
+    /** Width of column from sample of rows (see calculateTableWidth()). */
+    int sampledColumnWidth(int column);
+    static const int kSampleRows = 256;   /**< rows measured per column */
+    static const int kCellMargin = 4;     /**< padding of cell text */
+    bool uniformRowHeight;                /**< rows are not measured */
 
     int currPage;                         /**< current page */
-    QVector<QVector<QStringList> > pages; /**< vector with all data/boxes */
+    BoxDocument document;                 /**< all data/boxes */
+    QThreadPool savePool;                 /**< runs saveJob */
+    BoxSaveJob* saveJob;                  /**< running save or 0 */
+    int editGeneration;                   /**< incremented on every edit */
+    int saveGeneration;                   /**< editGeneration of saveJob */
+    bool finishSave();
+    BoxJournal journal;                   /**< edits not saved yet */
+    qint64 saveJournalPosition;           /**< journal end at save start */
+    bool journalBlocked;                  /**< table is being filled */
+    QVector<QVector<int> > pageGlyphCounts;  /**< glyph counts of pages */
+    QVector<bool> pageGlyphCountsValid;
+    QVector<int> glyphCountTotal;         /**< sum of valid page counts */
+    /** Count page (all pages if -1) again in next glyphCounts(). */
+    void invalidateGlyphCounts(int page = -1);
+    int editDepth;                        /**< nesting of beginEdit() */
+    bool editPending;                     /**< model changed in edit */
+    /** Glyph ids whose text contains symbol. */
+    QVector<bool> matchingGlyphs(const QString& symbol,
+                                 Qt::CaseSensitivity mc);
+    /** Format model row as box file line. */
+    QByteArray formatRow(int row);
+    /** Offer edits of previous session found in journal of fileName. */
+    void recoverJournal(const QString& fileName);
     /** Read data from vector and show them in table.
      *  It takes data for current page from vector and puts it to table view.
      */
     bool fillTableData(int pageNum);
-    /** Read data from textstream and put them to 'pages'.
-     *  It takes data from file stream and converts them to vector per page
-     *  and box.
+    /** Read data from device and put them to document.
+     *  It streams data from device through BoxParser and converts them to
+     *  vector per page and box.
      */
-    bool readToVector(QTextStream &boxdata);
-    /** Store current page to pages.
+    bool readToVector(QIODevice* boxdata);
+    /** Store current page to document.
      *  It takes data from table view and put it to vector that keeps data
      *  of all pages.
      */
@@ -285,15 +398,43 @@ class ChildWidget : public QSplitter {
      */
     void cleanTable();
     void loadTable();
+    /**
+     * Recently visited pages (models, box layers and images) by page
+     * number, cost is in KiB. Page becomes cached when other page is shown.
+     */
+    QCache<int, PageView> pageCache;
+    /** Move shown page to pageCache (nothing is shown afterwards). */
+    void cachePage();
+    /** Show page taken from pageCache, view is deleted. */
+    void showCachedPage(PageView* view);
+    /** Make new box layer for shown page. */
+    void newBoxLayer();
+    /** Warn about format/read error of last document operation */
+    void showDocumentError();
+    /** Collect all problems of box file that could not be loaded. */
+    bool validateFile(const QString& fileName);
+    bool loadGzipBoxes(const QString& fileName);
+    QVector<BoxIssue> boxIssues;
 
   private slots:
     void documentWasModified();
-    void emitBoxChanged();
+    void modelChanged();
+    void invalidateSelectionCache();
     bool slotChangePage(int sbdPage);
     void selectionChanged(const QItemSelection& selected,
                           const QItemSelection& deselected);
     void updateSelectionRects();
     void slotfileChanged(const QString& fileName);
+    void slotSaveFinished();
+    void journalRowsInserted(const QModelIndex& parent, int first, int last);
+    void journalRowsRemoved(const QModelIndex& parent, int first, int last);
+    void journalDataChanged(const QModelIndex& topLeft,
+                            const QModelIndex& bottomRight);
+    void layerRowsInserted(const QModelIndex& parent, int first, int last);
+    void layerRowsRemoved(const QModelIndex& parent, int first, int last);
+    void layerDataChanged(const QModelIndex& topLeft,
+                          const QModelIndex& bottomRight);
+    void layerReset();
 
   signals:
     void boxChanged();
@@ -302,6 +443,7 @@ class ChildWidget : public QSplitter {
     void zoomRatioChanged(qreal);
     void statusBarMessage(QString);
     void drawRectangleChoosen();
+    void issuesChanged();
 
   protected:
     bool directType(QKeyEvent* event);
@@ -330,16 +472,20 @@ class ChildWidget : public QSplitter {
     QLabel* numberOfPages;
     QSpinBox* currentPage;
 
-    // Returns model item's associated bbox. "row" determines item's row number.
+    // Returns bbox of model item. "row" determines item's row number.
     // If row = -1 then returns bbox of the last item in current selection
-    QGraphicsRectItem* modelItemBox(int row = -1);
-    QGraphicsRectItem* createModelItemBox(int row);
-    void updateModelItemBox(int row);
-    void deleteModelItemBox(int row);
+    QRect modelItemBox(int row = -1);
+    // Bbox from coordinates in model (image coordinates)
+    QRect modelRect(int row);
+    // Rows of boxes with center inside of rubber band (sorted)
+    QVector<int> rubberBandRows();
+
+    // Boxes of all rows of table (one graphics item)
+    BoxLayer* boxLayer;
 
     QTableView* table;
 
-    QStandardItemModel* model;
+    BoxTableModel* model;
     QItemSelectionModel* selectionModel;
 
     QString imageFile;
@@ -361,30 +507,39 @@ class ChildWidget : public QSplitter {
 
     DragResizer* resizer;
 
-    template<class T>
-    class UndoStack : public QStack<T> {
+    // Undo items are kept packed (see packUndoItem()) in BoxUndoLog
+    class UndoStack {
       public:
-        void SetRedoStack(QStack<T>* pRedoStack) {
+        UndoStack() : m_pRedoStack(0), m_store(0) {}
+
+        void SetRedoStack(UndoStack* pRedoStack) {
             m_pRedoStack = pRedoStack;
         }
+        /** Glyph table of letters in items. */
+        void setStore(BoxStore* store) {
+            m_store = store;
+        }
+        void setMemoryLimit(qint64 bytes) {
+            m_log.setMemoryLimit(bytes);
+        }
 
-        // Overide
-        void push(const T &t, bool bClearRedo = true) {
-            // When a new undo item is push we need
-            // To clear the redo stack.
-            if (m_pRedoStack && bClearRedo) {
-                m_pRedoStack->clear();
-            }
-            // Now call base class implementation
-            QStack<T>::push(t);
+        void push(const UndoItem& t, bool bClearRedo = true);
+        UndoItem pop();
+        bool isEmpty() const {
+            return m_log.isEmpty();
+        }
+        void clear() {
+            m_log.clear();
         }
 
       private:
-        QStack<T>*  m_pRedoStack;
+        UndoStack*  m_pRedoStack;
+        BoxStore* m_store;
+        BoxUndoLog m_log;
     };
 
-    UndoStack<UndoItem> m_undostack;
-    QStack<UndoItem> m_redostack;
+    UndoStack m_undostack;
+    UndoStack m_redostack;
     bool bIsSpinBoxChanged;
     bool bIsLineEditChanged;
 };
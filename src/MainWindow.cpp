@@ -41,6 +41,10 @@ MainWindow::MainWindow() {
           SLOT(updateCommandActions()));
   connect(tabWidget, SIGNAL(currentChanged(int)), this,
           SLOT(updateSaveAction()));
+  connect(tabWidget, SIGNAL(currentChanged(int)), this,
+          SLOT(updateIssues()));
+  connect(tabWidget, SIGNAL(currentChanged(int)), this,
+          SLOT(updateUnicharset()));
 
   setCentralWidget(tabWidget);
 
@@ -51,6 +55,7 @@ MainWindow::MainWindow() {
   shortCutsDialog = 0;
   setAcceptDrops(true);
   tabWidget->setAcceptDrops(true);
+  createDockWindows();  // before menus, view menu toggles the docks
   createActions();
   createMenus();
   createToolBars();
@@ -122,7 +127,10 @@ void MainWindow::addChild(const QString& imageFileName) {
       connect(child, SIGNAL(statusBarMessage(QString)), this,
               SLOT(statusBarMessage(QString)));
       connect(child, SIGNAL(drawRectangleChoosen()), this, SLOT(updateCommandActions()));
+      connect(child, SIGNAL(issuesChanged()), this, SLOT(updateIssues()));
+      connect(child, SIGNAL(boxChanged()), this, SLOT(updateUnicharset()));
       child->setZoomStatus();
+      updateIssues();
       // save path of open image file
       QSettings settings(QSettings::IniFormat, QSettings::UserScope,
                          SETTING_ORGANIZATION, SETTING_APPLICATION);
@@ -143,6 +151,11 @@ void MainWindow::addChild(const QString& imageFileName) {
           mainWin->updateRecentFileActions();
       }
     } else {
+      // Problems of box file that was not loaded
+      if (!child->issues().isEmpty())
+        showIssues(QFileInfo(
+                     ChildWidget::boxFileName(imageFileName)).fileName(),
+                   child->issues());
       child->close();
     }
   }
@@ -171,8 +184,9 @@ void MainWindow::updateRecentFileActions() {
 void MainWindow::save() {
   QString fileName = activeChild()->currentBoxFile();
 
-  if (activeChild() && activeChild()->save(fileName))
-    statusBar()->showMessage(tr("File saved"), 2000);
+  // ChildWidget reports finished save by statusBarMessage()
+  if (activeChild())
+    activeChild()->save(fileName);
 }
 
 /**
@@ -202,13 +216,14 @@ void MainWindow::saveAs() {
   QString fileName = QFileDialog::getSaveFileName(this,
                      tr("Save a copy of box file..."),
                      currentFileName,
-                     tr("Tesseract-ocr box files (*.box);;All files (*)"));
+                     tr("Tesseract-ocr box files (*.box *.box.gz);;"
+                        "All files (*)"));
 
   if (fileName.isEmpty())
     return;
 
-  if (activeChild() && activeChild()->save(fileName))
-    statusBar()->showMessage(tr("File saved"), 2000);
+  if (activeChild())
+    activeChild()->save(fileName);
 }
 
 void MainWindow::reLoad() {
@@ -476,6 +491,92 @@ void MainWindow::goToRow() {
   }
 }
 
+void MainWindow::validateBoxes() {
+  if (activeChild()) {
+    activeChild()->validateBoxes();
+  }
+}
+
+void MainWindow::updateIssues() {
+  if (activeChild())
+    showIssues(activeChild()->userFriendlyCurrentFile(),
+               activeChild()->issues());
+  else
+    showIssues(QString(), QVector<BoxIssue>());
+}
+
+void MainWindow::showIssues(const QString& fileName,
+                            const QVector<BoxIssue>& issues) {
+  issuesList->clear();
+  issuesDock->setWindowTitle(issues.isEmpty() ? tr("Box issues")
+                             : tr("Box issues - %1 (%2)").arg(fileName)
+                             .arg(issues.size()));
+  for (int i = 0; i < issues.size(); ++i) {
+    const BoxIssue& issue = issues.at(i);
+    QString text;
+    if (issue.line > 0)
+      text = tr("Line %1: %2").arg(issue.line).arg(issue.message());
+    else if (issue.row >= 0)
+      text = tr("Page %1, row %2: %3").arg(issue.page + 1).arg(issue.row + 1)
+             .arg(issue.message());
+    else
+      text = issue.message();
+    QListWidgetItem* item = new QListWidgetItem(text, issuesList);
+    item->setData(Qt::UserRole, issue.page);
+    item->setData(Qt::UserRole + 1, issue.row);
+  }
+  if (!issues.isEmpty())
+    issuesDock->show();
+}
+
+void MainWindow::goToIssue(QListWidgetItem* item) {
+  int page = item->data(Qt::UserRole).toInt();
+  int row = item->data(Qt::UserRole + 1).toInt();
+  if (activeChild() && page >= 0)
+    activeChild()->goToBox(page, row);
+}
+
+/*
+ * Unicharset is counted only while dock is visible - counting of other pages
+ * is cached by child, current page is counted on every update.
+ */
+void MainWindow::updateUnicharset() {
+  if (unicharsetDock->isHidden())
+    return;
+
+  unicharsetTree->setSortingEnabled(false);
+  unicharsetTree->clear();
+  ChildWidget* child = activeChild();
+  if (!child) {
+    unicharsetDock->setWindowTitle(tr("Unicharset"));
+    return;
+  }
+
+  QVector<int> counts = child->glyphCounts();
+  QList<QTreeWidgetItem*> items;
+  for (int id = 0; id < counts.size(); ++id) {
+    if (counts.at(id) == 0)
+      continue;  // glyph is not used (anymore)
+    QString glyph = child->glyphs().glyph(id);
+    QTreeWidgetItem* item = new QTreeWidgetItem();
+    item->setText(0, glyph);
+    item->setText(1, ChildWidget::symbolHexCode(glyph));
+    item->setData(2, Qt::DisplayRole, counts.at(id));
+    item->setData(0, Qt::UserRole, id);
+    items.append(item);
+  }
+  unicharsetTree->addTopLevelItems(items);
+  unicharsetTree->setSortingEnabled(true);
+  unicharsetDock->setWindowTitle(tr("Unicharset - %1 (%2)")
+                                 .arg(child->userFriendlyCurrentFile())
+                                 .arg(items.size()));
+}
+
+void MainWindow::goToGlyph(QTreeWidgetItem* item) {
+  if (activeChild())
+    activeChild()->findGlyph(item->data(0, Qt::UserRole).toInt());
+}
+
 void MainWindow::find() {
   if (activeChild()) {
     activeChild()->find();
@@ -667,6 +768,7 @@ void MainWindow::updateMenus() {
   showSymbolAct->setEnabled(activeChild() != 0);
   goToRowAct->setEnabled(activeChild() != 0);
   findAct->setEnabled(activeChild() != 0);
+  validateAct->setEnabled(activeChild() != 0);
   undoAct->setEnabled(activeChild() != 0);
   redoAct->setEnabled(activeChild() != 0);
   drawRectAct->setEnabled(activeChild() != 0);
@@ -763,6 +865,9 @@ void MainWindow::updateViewMenu() {
   viewMenu->addAction(showSymbolAct);
   viewMenu->addAction(showFontColumnsAct);
   viewMenu->addAction(drawBoxesAct);
+  viewMenu->addSeparator();
+  viewMenu->addAction(issuesDock->toggleViewAction());
+  viewMenu->addAction(unicharsetDock->toggleViewAction());
 }
 
 void MainWindow::createActions() {
@@ -1019,6 +1124,10 @@ void MainWindow::createActions() {
   findAct->setShortcut(tr("Ctrl+F"));
   connect(findAct, SIGNAL(triggered()), this, SLOT(find()));
 
+  validateAct = new QAction(tr("&Validate boxes"), this);
+  validateAct->setStatusTip(tr("Check all boxes and list the problems"));
+  connect(validateAct, SIGNAL(triggered()), this, SLOT(validateBoxes()));
+
   drawRectAct = new QAction(QIcon::fromTheme("rectangle"),
                             tr("Draw/Hide &Rectangle…"), this);
   drawRectAct->setCheckable(true);
@@ -1125,6 +1234,7 @@ void MainWindow::createMenus() {
   editMenu->addAction(moveToAct);
   editMenu->addAction(goToRowAct);
   editMenu->addAction(findAct);
+  editMenu->addAction(validateAct);
   editMenu->addSeparator();
   editMenu->addAction(DirectTypingAct);
   editMenu->addAction(drawRectAct);
@@ -1211,6 +1321,32 @@ void MainWindow::createStatusBar() {
   statusBar()->addWidget(_zoom, 1);
 }
 
+void MainWindow::createDockWindows() {
+  issuesDock = new QDockWidget(tr("Box issues"), this);
+  issuesDock->setObjectName("issuesDock");
+  issuesList = new QListWidget(issuesDock);
+  issuesDock->setWidget(issuesList);
+  addDockWidget(Qt::BottomDockWidgetArea, issuesDock);
+  issuesDock->hide();
+  connect(issuesList, SIGNAL(itemActivated(QListWidgetItem*)), this,
+          SLOT(goToIssue(QListWidgetItem*)));
+
+  unicharsetDock = new QDockWidget(tr("Unicharset"), this);
+  unicharsetDock->setObjectName("unicharsetDock");
+  unicharsetTree = new QTreeWidget(unicharsetDock);
+  unicharsetTree->setRootIsDecorated(false);
+  unicharsetTree->setHeaderLabels(QStringList() << tr("Glyph") << tr("Codes")
+                                  << tr("Count"));
+  unicharsetTree->sortByColumn(2, Qt::DescendingOrder);
+  unicharsetDock->setWidget(unicharsetTree);
+  addDockWidget(Qt::RightDockWidgetArea, unicharsetDock);
+  unicharsetDock->hide();
+  connect(unicharsetDock, SIGNAL(visibilityChanged(bool)), this,
+          SLOT(updateUnicharset()));
+  connect(unicharsetTree, SIGNAL(itemActivated(QTreeWidgetItem*, int)), this,
+          SLOT(goToGlyph(QTreeWidgetItem*)));
+}
+
 void MainWindow::readSettings(bool init) {
   QSettings settings(QSettings::IniFormat, QSettings::UserScope,
                      SETTING_ORGANIZATION, SETTING_APPLICATION);
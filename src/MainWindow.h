@@ -33,14 +33,17 @@
 #include <QUrl>
 #include <QAction>
 #include <QCloseEvent>
+#include <QDockWidget>
 #include <QFileDialog>
 #include <QFont>
+#include <QListWidget>
 #include <QMainWindow>
 #include <QMenu>
 #include <QMenuBar>
 #include <QMessageBox>
 #include <QMimeData>
 #include <QStatusBar>
+#include <QTreeWidget>
 #include <QStyle>
 #include <QStyleFactory>
 #include <QToolBar>
@@ -119,6 +122,11 @@ class MainWindow : public QMainWindow {
     void moveTo();
     void goToRow();
     void find();
+    void validateBoxes();
+    void updateIssues();
+    void goToIssue(QListWidgetItem* item);
+    void updateUnicharset();
+    void goToGlyph(QTreeWidgetItem* item);
     void drawRect(bool checked);
     void undo();
     void redo();
@@ -144,6 +152,8 @@ class MainWindow : public QMainWindow {
     void createMenus();
     void createToolBars();
     void createStatusBar();
+    void createDockWindows();
+    void showIssues(const QString& fileName, const QVector<BoxIssue>& issues);
     void readSettings(bool init);
     void writeSettings();
     void checkVersion(QNetworkReply* reply);
@@ -215,6 +225,7 @@ class MainWindow : public QMainWindow {
     QAction* moveDownAct;
     QAction* goToRowAct;
     QAction* findAct;
+    QAction* validateAct;
     QAction* drawRectAct;
     QAction* undoAct;
     QAction* redoAct;
@@ -227,6 +238,10 @@ class MainWindow : public QMainWindow {
     QLabel* _utfCodeLabel;
     QLabel* _boxsize;
     QLabel* _zoom;
+    QDockWidget* issuesDock;
+    QListWidget* issuesList;
+    QDockWidget* unicharsetDock;
+    QTreeWidget* unicharsetTree;
 
     bool openSettings;
 };